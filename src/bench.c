@@ -0,0 +1,446 @@
+#include "engine.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+// Runs a corpus of reduction problems and reports performance as JSON.
+//
+// Each nonblank line of a corpus is a category name followed by a term, as
+// parsed by un_parse_ex. Lines starting with # are comments. Each query
+// simplifies its term, which is memoized, then computes the result with a
+// budget, which is not. Each repeat uses a fresh engine, so memo hits count
+// only sharing within one pass over the corpus.
+//
+// With --threads N, this also measures lock-free memo lookups in a shared
+// engine on 1, 2, 4, ... N threads. The lookups are apps of a few heads to
+// the normal forms of the corpus, all memoized before timing starts.
+//
+// With --merges N, this also measures merges/sec while reducing N random
+// terms, built without reducing from linear atoms and variables. Reducing a
+// pending app merges it into its normal form, and merges are processed after
+// every chunk of MERGE_CHUNK apps, as a caller reducing incrementally would.
+
+#define MAX_CATEGORIES 64
+#define LOOKUPS_PER_THREAD (1UL << 20U)
+#define MERGE_TERM_SIZE 64
+#define MERGE_CHUNK 64
+
+// Counters are zero when the library is built without statistics, so they
+// are reported as null rather than as a measured 0.
+#ifdef HSTAR_NO_STATS
+#define STATS false
+#else  // HSTAR_NO_STATS
+#define STATS true
+#endif  // HSTAR_NO_STATS
+
+typedef struct {
+    const char *category;
+    const char *term;
+} Query;
+
+typedef struct {
+    const char *name;
+    size_t queries;
+    size_t skipped;
+    double seconds;
+    uint64_t reductions;
+    size_t capacity;  // Of latencies, which holds one per query.
+    double *latencies;
+} Category;
+
+typedef struct {
+    un_engine_t *engine;
+    const Ob *lhs;
+    const Ob *rhs;
+    size_t count;  // Of keys.
+    size_t start;
+} LookupTask;
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [--repeat N] [--budget N] [--threads N] "
+            "[--merges N] CORPUS\n",
+            name);
+    exit(2);
+}
+
+static void die(const char *message, const char *arg) {
+    fprintf(stderr, "ERROR %s: %s\n", message, arg);
+    exit(1);
+}
+
+static void *realloc_or_die(void *ptr, size_t size, const char *what) {
+    ptr = realloc(ptr, size);
+    if (!ptr) die("out of memory for", what);
+    return ptr;
+}
+
+static char *read_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) die("cannot open", path);
+    size_t size = 0;
+    size_t capacity = 4096;
+    char *text = realloc_or_die(NULL, capacity, path);
+    size_t count;
+    while ((count = fread(text + size, 1, capacity - size - 1, file))) {
+        size += count;
+        if (size + 1 == capacity) {
+            capacity *= 2;
+            text = realloc_or_die(text, capacity, path);
+        }
+    }
+    if (ferror(file)) die("cannot read", path);
+    fclose(file);
+    text[size] = '\0';
+    return text;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Splits a corpus in place into queries, returning their number.
+static size_t parse_corpus(char *text, Query **queries) {
+    size_t count = 0;
+    size_t capacity = 64;
+    *queries = realloc_or_die(NULL, capacity * sizeof(Query), "queries");
+    for (char *line = text; line;) {
+        char *end = strchr(line, '\n');
+        if (end) *end = '\0';
+        char *next = end ? end + 1 : NULL;
+        while (is_space(*line)) ++line;
+        if (*line && *line != '#') {
+            char *term = line;
+            while (*term && !is_space(*term)) ++term;
+            if (!*term) die("missing term", line);
+            *term++ = '\0';
+            if (count == capacity) {
+                capacity *= 2;
+                *queries = realloc_or_die(*queries, capacity * sizeof(Query),
+                                          "queries");
+            }
+            (*queries)[count].category = line;
+            (*queries)[count].term = term;
+            ++count;
+        }
+        line = next;
+    }
+    return count;
+}
+
+static Category *find_category(Category *categories, size_t *count,
+                               const char *name) {
+    for (size_t i = 0; i != *count; ++i) {
+        if (!strcmp(categories[i].name, name)) return categories + i;
+    }
+    if (*count == MAX_CATEGORIES) die("too many categories", name);
+    Category *category = categories + (*count)++;
+    memset(category, 0, sizeof(Category));
+    category->name = name;
+    return category;
+}
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + 1e-9 * (double)time.tv_nsec;
+}
+
+// Prints a string as a JSON string literal.
+static void print_string(const char *string) {
+    putchar('"');
+    for (const unsigned char *c = (const unsigned char *)string; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            printf("\\%c", *c);
+        } else if (*c < 0x20) {
+            printf("\\u%04x", *c);
+        } else {
+            putchar(*c);
+        }
+    }
+    putchar('"');
+}
+
+// Prints a counter, or null if statistics are compiled out.
+static void print_count(uint64_t count) {
+    if (STATS) {
+        printf("%llu", (unsigned long long)count);
+    } else {
+        printf("null");
+    }
+}
+
+// Prints a ratio of counters, or null if it is undefined.
+static void print_ratio(double numerator, double denominator) {
+    if (STATS && denominator > 0.0) {
+        printf("%.4f", numerator / denominator);
+    } else {
+        printf("null");
+    }
+}
+
+static int compare_doubles(const void *x, const void *y) {
+    const double lhs = *(const double *)x;
+    const double rhs = *(const double *)y;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+// Returns the q-th quantile of sorted values, by the nearest-rank method.
+static double quantile(const double *values, size_t count, double q) {
+    if (!count) return 0.0;
+    size_t rank = (size_t)(q * (double)count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return values[rank - 1];
+}
+
+// Sorts latencies in seconds and prints their quantiles in microseconds.
+static void print_latency(double *latencies, size_t count) {
+    qsort(latencies, count, sizeof(double), compare_doubles);
+    printf("{\"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+           1e6 * quantile(latencies, count, 0.50),
+           1e6 * quantile(latencies, count, 0.99),
+           1e6 * quantile(latencies, count, 1.00));
+}
+
+static void *run_lookups(void *arg) {
+    const LookupTask *task = arg;
+    size_t i = task->start;
+    for (size_t step = 0; step != LOOKUPS_PER_THREAD; ++step) {
+        un_simplify_app_ex(task->engine, task->lhs[i], task->rhs[i]);
+        if (++i == task->count) i = 0;
+    }
+    return NULL;
+}
+
+// Prints lookups/sec for each thread count, as a JSON list.
+static void print_lookups(const Query *queries, size_t query_count,
+                          long threads) {
+    static const char *const heads[] = {"K", "C K", "B K"};
+    enum { head_count = sizeof(heads) / sizeof(heads[0]) };
+    un_engine_t *engine = un_engine_new_shared(0);
+    Ob *lhs = realloc_or_die(NULL, (query_count * head_count + 1) * sizeof(Ob),
+                             "keys");
+    Ob *rhs = realloc_or_die(NULL, (query_count * head_count + 1) * sizeof(Ob),
+                             "keys");
+    size_t count = 0;
+    for (size_t i = 0; i != query_count; ++i) {
+        const char *term = queries[i].term;
+        const Ob ob = un_parse_ex(engine, term, strlen(term));
+        if (!ob) continue;
+        const Ob normal = un_simplify_ex(engine, ob);
+        for (int h = 0; h != head_count; ++h) {
+            lhs[count] = un_parse_ex(engine, heads[h], strlen(heads[h]));
+            rhs[count] = normal;
+            un_simplify_app_ex(engine, lhs[count], rhs[count]);
+            ++count;
+        }
+    }
+    if (!count) die("no lookups in", "corpus");
+
+    LookupTask *tasks =
+        realloc_or_die(NULL, (size_t)threads * sizeof(LookupTask), "tasks");
+    pthread_t *ids =
+        realloc_or_die(NULL, (size_t)threads * sizeof(pthread_t), "threads");
+    printf("  \"lookups\": [");
+    for (long n = 1;; n = n * 2 < threads ? n * 2 : threads) {
+        const double start = now();
+        for (long t = 0; t != n; ++t) {
+            tasks[t].engine = engine;
+            tasks[t].lhs = lhs;
+            tasks[t].rhs = rhs;
+            tasks[t].count = count;
+            tasks[t].start = (size_t)t * count / (size_t)n;
+            const int error =
+                pthread_create(ids + t, NULL, run_lookups, tasks + t);
+            if (error) die("cannot create thread", strerror(error));
+        }
+        for (long t = 0; t != n; ++t) pthread_join(ids[t], NULL);
+        const double seconds = now() - start;
+        printf("%s\n    {\"threads\": %ld, \"lookups_per_sec\": %.1f}",
+               n == 1 ? "" : ",", n,
+               (double)(LOOKUPS_PER_THREAD * (size_t)n) / seconds);
+        if (n == threads) break;
+    }
+    printf("\n  ],\n");
+    free(ids);
+    free(tasks);
+    free(rhs);
+    free(lhs);
+    un_engine_free(engine);
+}
+
+// Returns a random term of about size apps, built from atoms without
+// reducing.
+static Ob random_term(un_engine_t *engine, const Ob *atoms, size_t atom_count,
+                      size_t size, unsigned int *seed) {
+    if (!size) return atoms[(size_t)rand_r(seed) % atom_count];
+    const size_t lhs_size = (size_t)rand_r(seed) % size;
+    const Ob lhs = random_term(engine, atoms, atom_count, lhs_size, seed);
+    const Ob rhs =
+        random_term(engine, atoms, atom_count, size - 1 - lhs_size, seed);
+    return un_app_ex(engine, lhs, rhs);
+}
+
+// Prints merges/sec of reducing random terms, as a JSON object.
+static void print_merges(long terms) {
+    static const char *const names[] = {"I",  "K",  "B",  "C",  "x0", "x1",
+                                        "x2", "x3", "x4", "x5", "x6", "x7"};
+    enum { atom_count = sizeof(names) / sizeof(names[0]) };
+    un_engine_t *engine = un_engine_new(0);
+    Ob atoms[atom_count];
+    for (int i = 0; i != atom_count; ++i) {
+        atoms[i] = un_parse_ex(engine, names[i], strlen(names[i]));
+    }
+    unsigned int seed = 0;
+    for (long i = 0; i != terms; ++i) {
+        random_term(engine, atoms, atom_count, MERGE_TERM_SIZE, &seed);
+    }
+    size_t merges = 0;
+    size_t count;
+    const double start = now();
+    while ((count = un_reduce_pending_ex(engine, MERGE_CHUNK))) {
+        merges += count;
+    }
+    const double seconds = now() - start;
+    printf("  \"merges\": {\"terms\": %ld, \"merges\": %zu, "
+           "\"seconds\": %.6f, \"merges_per_sec\": %.1f},\n",
+           terms, merges, seconds, (double)merges / seconds);
+    un_engine_free(engine);
+}
+
+int main(int argc, char **argv) {
+    long repeat = 10;
+    long budget = 1000;
+    long threads = 0;
+    long merges = 0;
+    const char *path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+            repeat = strtol(argv[++i], NULL, 10);
+            if (repeat < 1) usage(argv[0]);
+        } else if (!strcmp(argv[i], "--budget") && i + 1 < argc) {
+            budget = strtol(argv[++i], NULL, 10);
+            if (budget < 0) usage(argv[0]);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = strtol(argv[++i], NULL, 10);
+            if (threads < 1) usage(argv[0]);
+        } else if (!strcmp(argv[i], "--merges") && i + 1 < argc) {
+            merges = strtol(argv[++i], NULL, 10);
+            if (merges < 1) usage(argv[0]);
+        } else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (!path) usage(argv[0]);
+
+    char *text = read_file(path);
+    Query *queries;
+    const size_t query_count = parse_corpus(text, &queries);
+    Category categories[MAX_CATEGORIES];
+    size_t category_count = 0;
+    for (size_t i = 0; i != query_count; ++i) {
+        find_category(categories, &category_count, queries[i].category)
+            ->capacity += (size_t)repeat;
+    }
+    for (size_t i = 0; i != category_count; ++i) {
+        categories[i].latencies = realloc_or_die(
+            NULL, (categories[i].capacity + 1) * sizeof(double), "latencies");
+    }
+    double *latencies = realloc_or_die(
+        NULL, (query_count * (size_t)repeat + 1) * sizeof(double), "latencies");
+    size_t latency_count = 0;
+    size_t skipped = 0;
+    un_stats_t total;
+    memset(&total, 0, sizeof(total));
+    double seconds = 0.0;
+
+    for (long r = 0; r != repeat; ++r) {
+        un_engine_t *engine = un_engine_new(0);
+        for (size_t i = 0; i != query_count; ++i) {
+            Category *category = find_category(categories, &category_count,
+                                               queries[i].category);
+            const char *term = queries[i].term;
+            const Ob ob = un_parse_ex(engine, term, strlen(term));
+            if (!ob) {
+                ++category->skipped;
+                ++skipped;
+                continue;
+            }
+            un_stats_t before, after;
+            un_stats_snapshot_ex(engine, &before);
+            int query_budget = (int)budget;
+            const double start = now();
+            un_compute_ex(engine, un_simplify_ex(engine, ob), &query_budget);
+            const double latency = now() - start;
+            un_stats_snapshot_ex(engine, &after);
+            latencies[latency_count++] = latency;
+            seconds += latency;
+            category->latencies[category->queries++] = latency;
+            category->seconds += latency;
+            category->reductions += after.reductions - before.reductions;
+            total.reductions += after.reductions - before.reductions;
+            total.memo_hits += after.memo_hits - before.memo_hits;
+            total.memo_misses += after.memo_misses - before.memo_misses;
+        }
+        un_engine_free(engine);
+    }
+
+    struct rusage resources;
+    getrusage(RUSAGE_SELF, &resources);
+    const uint64_t lookups = total.memo_hits + total.memo_misses;
+
+    printf("{\n");
+    printf("  \"corpus\": ");
+    print_string(path);
+    printf(",\n");
+    printf("  \"stats\": %s,\n", STATS ? "true" : "false");
+    printf("  \"repeat\": %ld,\n", repeat);
+    printf("  \"budget\": %ld,\n", budget);
+    printf("  \"queries\": %zu,\n", latency_count);
+    printf("  \"skipped\": %zu,\n", skipped);
+    printf("  \"seconds\": %.6f,\n", seconds);
+    printf("  \"reductions\": ");
+    print_count(total.reductions);
+    printf(",\n  \"reductions_per_sec\": ");
+    print_ratio((double)total.reductions, seconds);
+    printf(",\n  \"memo_hits\": ");
+    print_count(total.memo_hits);
+    printf(",\n  \"memo_misses\": ");
+    print_count(total.memo_misses);
+    printf(",\n  \"memo_hit_rate\": ");
+    print_ratio((double)total.memo_hits, (double)lookups);
+    printf(",\n");
+    printf("  \"latency_us\": ");
+    print_latency(latencies, latency_count);
+    printf(",\n");
+    printf("  \"peak_rss_kb\": %ld,\n", (long)resources.ru_maxrss);
+    if (threads) print_lookups(queries, query_count, threads);
+    if (merges) print_merges(merges);
+    printf("  \"categories\": {");
+    for (size_t i = 0; i != category_count; ++i) {
+        Category *category = categories + i;
+        printf("%s\n    ", i ? "," : "");
+        print_string(category->name);
+        printf(": {\"queries\": %zu, \"skipped\": %zu, \"reductions\": ",
+               category->queries, category->skipped);
+        print_count(category->reductions);
+        printf(", \"seconds\": %.6f, \"latency_us\": ", category->seconds);
+        print_latency(category->latencies, category->queries);
+        printf("}");
+        free(category->latencies);
+    }
+    printf("\n  }\n}\n");
+
+    free(latencies);
+    free(queries);
+    free(text);
+    return 0;
+}
@@ -1,13 +1,411 @@
 #include "engine.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-int main(int argc, char **argv) {
-    un_init(1UL << 20UL);
+// Simplifies newline-delimited terms from a file or stdin, printing each
+// result on the corresponding line of stdout.
+//
+// Work flows through three stages, each a thread: a reader splits input
+// into batches of lines, an evaluator parses and simplifies each batch, and
+// a printer writes batches in order. Batches come from a fixed pool, which
+// bounds memory and keeps output deterministic. Regular files are mapped,
+// so lines are never copied; streams are read into batch buffers.
+
+#define BATCH_BYTES (1UL << 20UL)  // Input bytes per batch, at least.
+#define BATCH_COUNT 4              // Batches in flight.
+
+typedef struct {
+    const char *text;
+    size_t size;
+} Line;
+
+typedef struct {
+    char *buffer;  // Holds lines read from a stream.
+    size_t buffer_capacity;
+    Line *lines;
+    Ob *obs;  // Results, or 0 for invalid lines.
+    size_t line_count;
+    size_t line_capacity;
+    size_t first_line;  // Number of lines[0], counting from 1.
+} Batch;
+
+// A FIFO of batches, ended by NULL. Each can hold the whole pool, so pushes
+// never block.
+typedef struct {
+    Batch *batches[BATCH_COUNT + 1];
+    size_t head;
+    size_t count;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} Channel;
+
+typedef struct {
+    un_engine_t *engine;
+    Batch batches[BATCH_COUNT];
+    Channel free;
+    Channel read;
+    Channel evaluated;
+
+    // Input is either mapped or read from fd.
+    char *map;
+    size_t map_size;
+    size_t map_pos;
+    int fd;
+    bool eof;
+    char *carry;  // A partial line read from fd.
+    size_t carry_size;
+    size_t carry_capacity;
+    size_t line_count;
+} Pipeline;
+
+static void die(const char *message, const char *arg) {
+    fprintf(stderr, "ERROR %s: %s\n", message, arg);
+    exit(1);
+}
+
+static void *malloc_or_die(size_t size) {
+    void *ptr = malloc(size);
+    if (!ptr) die("out of memory", "malloc");
+    return ptr;
+}
+
+static void *realloc_or_die(void *ptr, size_t size) {
+    ptr = realloc(ptr, size);
+    if (!ptr) die("out of memory", "realloc");
+    return ptr;
+}
+
+static void Channel_init(Channel *channel) {
+    memset(channel, 0, sizeof(Channel));
+    pthread_mutex_init(&channel->mutex, NULL);
+    pthread_cond_init(&channel->cond, NULL);
+}
 
+static void Channel_destroy(Channel *channel) {
+    pthread_cond_destroy(&channel->cond);
+    pthread_mutex_destroy(&channel->mutex);
+}
+
+static void Channel_push(Channel *channel, Batch *batch) {
+    pthread_mutex_lock(&channel->mutex);
+    const size_t capacity = BATCH_COUNT + 1;
+    channel->batches[(channel->head + channel->count++) % capacity] = batch;
+    pthread_cond_signal(&channel->cond);
+    pthread_mutex_unlock(&channel->mutex);
+}
+
+static Batch *Channel_pop(Channel *channel) {
+    pthread_mutex_lock(&channel->mutex);
+    while (!channel->count) pthread_cond_wait(&channel->cond, &channel->mutex);
+    Batch *batch = channel->batches[channel->head];
+    channel->head = (channel->head + 1) % (BATCH_COUNT + 1);
+    --channel->count;
+    pthread_mutex_unlock(&channel->mutex);
+    return batch;
+}
+
+// Splits text[0, size) into lines, without copying.
+static void Batch_split(Pipeline *pipeline, Batch *batch, const char *text,
+                        size_t size) {
+    batch->line_count = 0;
+    batch->first_line = pipeline->line_count + 1;
+    for (const char *end = text + size; text != end;) {
+        const char *newline = memchr(text, '\n', (size_t)(end - text));
+        const char *line_end = newline ? newline : end;
+        if (batch->line_count == batch->line_capacity) {
+            batch->line_capacity = batch->line_capacity * 2 + 64;
+            batch->lines = realloc_or_die(
+                batch->lines, batch->line_capacity * sizeof(Line));
+            batch->obs =
+                realloc_or_die(batch->obs, batch->line_capacity * sizeof(Ob));
+        }
+        batch->lines[batch->line_count].text = text;
+        batch->lines[batch->line_count].size = (size_t)(line_end - text);
+        ++batch->line_count;
+        text = newline ? newline + 1 : end;
+    }
+    pipeline->line_count += batch->line_count;
+}
+
+// Fills a batch from the mapping. Returns false at end of input.
+static bool Batch_fill_mapped(Pipeline *pipeline, Batch *batch) {
+    const size_t begin = pipeline->map_pos;
+    if (begin == pipeline->map_size) return false;
+    size_t end = pipeline->map_size;
+    if (end - begin > BATCH_BYTES) {
+        const char *newline = memchr(pipeline->map + begin + BATCH_BYTES,
+                                     '\n', end - begin - BATCH_BYTES);
+        if (newline) end = (size_t)(newline - pipeline->map) + 1;
+    }
+    pipeline->map_pos = end;
+    Batch_split(pipeline, batch, pipeline->map + begin, end - begin);
+    return true;
+}
+
+// Fills a batch from the stream, reading until it holds a whole line, so
+// that interactive input is not delayed. Returns false at end of input.
+static bool Batch_fill_stream(Pipeline *pipeline, Batch *batch) {
+    size_t size = pipeline->carry_size;
+    if (batch->buffer_capacity < BATCH_BYTES + size) {
+        batch->buffer_capacity = BATCH_BYTES + size;
+        batch->buffer = realloc_or_die(batch->buffer, batch->buffer_capacity);
+    }
+    memcpy(batch->buffer, pipeline->carry, size);
+    size_t end = 0;         // Of the last whole line.
+    size_t scanned = size;  // The carry holds no newline.
+    while (!end && !pipeline->eof) {
+        if (size == batch->buffer_capacity) {
+            batch->buffer_capacity *= 2;
+            batch->buffer =
+                realloc_or_die(batch->buffer, batch->buffer_capacity);
+        }
+        const ssize_t count = read(pipeline->fd, batch->buffer + size,
+                                   batch->buffer_capacity - size);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            die("cannot read input", strerror(errno));
+        }
+        if (count == 0) pipeline->eof = true;
+        size += (size_t)count;
+        for (size_t pos = size; pos-- > scanned;) {
+            if (batch->buffer[pos] == '\n') {
+                end = pos + 1;
+                break;
+            }
+        }
+        scanned = size;
+    }
+    if (pipeline->eof) end = size;
+    pipeline->carry_size = size - end;
+    if (pipeline->carry_capacity < pipeline->carry_size) {
+        pipeline->carry_capacity = pipeline->carry_size;
+        pipeline->carry = realloc_or_die(pipeline->carry,
+                                         pipeline->carry_capacity);
+    }
+    memcpy(pipeline->carry, batch->buffer + end, pipeline->carry_size);
+    if (!end) return false;
+    Batch_split(pipeline, batch, batch->buffer, end);
+    return true;
+}
+
+static void *read_batches(void *arg) {
+    Pipeline *pipeline = arg;
+    while (true) {
+        Batch *batch = Channel_pop(&pipeline->free);
+        const bool filled = pipeline->map
+                                ? Batch_fill_mapped(pipeline, batch)
+                                : Batch_fill_stream(pipeline, batch);
+        if (!filled) break;
+        Channel_push(&pipeline->read, batch);
+    }
+    Channel_push(&pipeline->read, NULL);
+    return NULL;
+}
+
+static void *evaluate_batches(void *arg) {
+    Pipeline *pipeline = arg;
+    un_engine_t *engine = pipeline->engine;
+    for (Batch *batch; (batch = Channel_pop(&pipeline->read));) {
+        for (size_t i = 0; i != batch->line_count; ++i) {
+            const Line *line = batch->lines + i;
+            const Ob ob = un_parse_ex(engine, line->text, line->size);
+            batch->obs[i] = ob ? un_simplify_ex(engine, ob) : 0;
+        }
+        Channel_push(&pipeline->evaluated, batch);
+    }
+    Channel_push(&pipeline->evaluated, NULL);
+    return NULL;
+}
+
+static bool is_blank(const Line *line) {
+    for (size_t i = 0; i != line->size; ++i) {
+        const char c = line->text[i];
+        if (c != ' ' && c != '\t' && c != '\r') return false;
+    }
+    return true;
+}
+
+// Prints batches in order, returning the number of invalid lines.
+static size_t print_batches(Pipeline *pipeline) {
+    size_t error_count = 0;
+    size_t capacity = BATCH_BYTES;
+    char *out = malloc_or_die(capacity);
+    for (Batch *batch; (batch = Channel_pop(&pipeline->evaluated));) {
+        size_t size = 0;
+        for (size_t i = 0; i != batch->line_count; ++i) {
+            size_t length = 0;
+            if (batch->obs[i]) {
+                // Retry until the text and its terminating nul fit.
+                while ((length = un_print_ex(pipeline->engine, batch->obs[i],
+                                             out + size, capacity - size)) >=
+                       capacity - size) {
+                    capacity = 2 * (size + length + 1);
+                    out = realloc_or_die(out, capacity);
+                }
+            } else if (!is_blank(batch->lines + i)) {
+                fprintf(stderr, "ERROR invalid term on line %zu\n",
+                        batch->first_line + i);
+                ++error_count;
+            }
+            if (size + length + 1 > capacity) {
+                capacity *= 2;
+                out = realloc_or_die(out, capacity);
+            }
+            size += length;
+            out[size++] = '\n';
+        }
+        if (fwrite(out, 1, size, stdout) != size) {
+            die("cannot write output", strerror(errno));
+        }
+        Channel_push(&pipeline->free, batch);
+    }
+    free(out);
+    return error_count;
+}
+
+static void print_histogram(const char *name, const uint64_t *counts) {
+    fprintf(stderr, "  \"%s\": [", name);
+    for (int i = 0; i != UN_STATS_PROBE_BUCKETS; ++i) {
+        fprintf(stderr, "%s%llu", i ? ", " : "", (unsigned long long)counts[i]);
+    }
+    fprintf(stderr, "],\n");
+}
+
+// Prints statistics as JSON to stderr.
+static void print_stats(const un_stats_t *stats) {
+    fprintf(stderr, "{\n");
+    fprintf(stderr, "  \"reductions\": %llu,\n",
+            (unsigned long long)stats->reductions);
+    fprintf(stderr,
+            "  \"reductions_by_head\": {\"TOP\": %llu, \"BOT\": %llu, "
+            "\"I\": %llu, \"K\": %llu, \"B\": %llu, \"C\": %llu, "
+            "\"S\": %llu, \"J\": %llu, \"native\": %llu},\n",
+            (unsigned long long)stats->reductions_by_head.top,
+            (unsigned long long)stats->reductions_by_head.bot,
+            (unsigned long long)stats->reductions_by_head.i,
+            (unsigned long long)stats->reductions_by_head.k,
+            (unsigned long long)stats->reductions_by_head.b,
+            (unsigned long long)stats->reductions_by_head.c,
+            (unsigned long long)stats->reductions_by_head.s,
+            (unsigned long long)stats->reductions_by_head.j,
+            (unsigned long long)stats->reductions_by_head.native);
+    fprintf(stderr, "  \"memo_hits\": %llu,\n",
+            (unsigned long long)stats->memo_hits);
+    fprintf(stderr, "  \"memo_misses\": %llu,\n",
+            (unsigned long long)stats->memo_misses);
+    print_histogram("find_probes", stats->find_probes);
+    print_histogram("insert_probes", stats->insert_probes);
+    fprintf(stderr, "  \"hash_grows\": %llu,\n",
+            (unsigned long long)stats->hash_grows);
+    fprintf(stderr, "  \"hash_grow_ns\": %llu,\n",
+            (unsigned long long)stats->hash_grow_ns);
+    fprintf(stderr, "  \"memo_evictions\": %llu,\n",
+            (unsigned long long)stats->memo_evictions);
+    fprintf(stderr, "  \"carrier_used\": %llu,\n",
+            (unsigned long long)stats->carrier_used);
+    fprintf(stderr, "  \"carrier_free_list\": %llu,\n",
+            (unsigned long long)stats->carrier_free_list);
+    fprintf(stderr, "  \"carrier_capacity\": %llu,\n",
+            (unsigned long long)stats->carrier_capacity);
+    fprintf(stderr, "  \"memo_count\": %llu,\n",
+            (unsigned long long)stats->memo_count);
+    fprintf(stderr, "  \"memo_capacity\": %llu,\n",
+            (unsigned long long)stats->memo_capacity);
+    fprintf(stderr, "  \"app_count\": %llu,\n",
+            (unsigned long long)stats->app_count);
+    fprintf(stderr, "  \"app_capacity\": %llu\n",
+            (unsigned long long)stats->app_capacity);
+    fprintf(stderr, "}\n");
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [--stats] [--memo-limit BYTES] [FILE]\n",
+            name);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    bool stats = false;
+    size_t memo_limit = 0;
+    const char *path = NULL;
     for (int i = 1; i < argc; ++i) {
-        printf("example %s -> TODO", argv[i]);
+        if (!strcmp(argv[i], "--stats")) {
+            stats = true;
+        } else if (!strcmp(argv[i], "--memo-limit") && i + 1 < argc) {
+            char *end;
+            memo_limit = strtoull(argv[++i], &end, 10);
+            if (*end || !memo_limit) usage(argv[0]);
+        } else if (!path && (argv[i][0] != '-' || !argv[i][1])) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+        }
     }
 
-    return 0;
+    Pipeline pipeline;
+    memset(&pipeline, 0, sizeof(Pipeline));
+    pipeline.fd = STDIN_FILENO;
+    if (path && strcmp(path, "-")) {
+        pipeline.fd = open(path, O_RDONLY);
+        if (pipeline.fd < 0) die("cannot open", path);
+    }
+    struct stat info;
+    if (!fstat(pipeline.fd, &info) && S_ISREG(info.st_mode) &&
+        info.st_size > 0) {
+        pipeline.map_size = (size_t)info.st_size;
+        void *map = mmap(NULL, pipeline.map_size, PROT_READ, MAP_PRIVATE,
+                         pipeline.fd, 0);
+        if (map != MAP_FAILED) {
+            posix_madvise(map, pipeline.map_size, POSIX_MADV_SEQUENTIAL);
+            pipeline.map = map;
+        }
+    }
+
+    pipeline.engine = un_engine_new_shared(0);
+    if (memo_limit) un_set_memo_limit_ex(pipeline.engine, memo_limit);
+    Channel_init(&pipeline.free);
+    Channel_init(&pipeline.read);
+    Channel_init(&pipeline.evaluated);
+    for (int i = 0; i != BATCH_COUNT; ++i) {
+        Channel_push(&pipeline.free, pipeline.batches + i);
+    }
+    pthread_t reader, evaluator;
+    int error = pthread_create(&reader, NULL, read_batches, &pipeline);
+    if (!error) {
+        error = pthread_create(&evaluator, NULL, evaluate_batches, &pipeline);
+    }
+    if (error) die("cannot create thread", strerror(error));
+    const size_t error_count = print_batches(&pipeline);
+    pthread_join(reader, NULL);
+    pthread_join(evaluator, NULL);
+    if (fflush(stdout)) die("cannot write output", strerror(errno));
+
+    if (stats) {
+        un_stats_t snapshot;
+        un_stats_snapshot_ex(pipeline.engine, &snapshot);
+        print_stats(&snapshot);
+    }
+
+    for (int i = 0; i != BATCH_COUNT; ++i) {
+        free(pipeline.batches[i].buffer);
+        free(pipeline.batches[i].lines);
+        free(pipeline.batches[i].obs);
+    }
+    free(pipeline.carry);
+    Channel_destroy(&pipeline.free);
+    Channel_destroy(&pipeline.read);
+    Channel_destroy(&pipeline.evaluated);
+    un_engine_free(pipeline.engine);
+    if (pipeline.map) munmap(pipeline.map, pipeline.map_size);
+    if (pipeline.fd != STDIN_FILENO) close(pipeline.fd);
+    return error_count ? 1 : 0;
 }
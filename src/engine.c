@@ -1,12 +1,26 @@
 #include "engine.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif  // defined(__SSE2__)
 
 // static_assert should be defined in assert.h.
 #if !defined(static_assert)
@@ -23,6 +37,25 @@
 #define unlikely(x) (x)
 #endif  // defined(__GNUC__) || defined(__clang__)
 
+// Atomic accesses, where order is one of RELAXED, ACQUIRE, RELEASE, SEQ_CST.
+#if defined(__GNUC__) || defined(__clang__)
+#define UN_ATOMIC_LOAD(ptr, order) __atomic_load_n((ptr), __ATOMIC_##order)
+#define UN_ATOMIC_STORE(ptr, val, order) \
+    __atomic_store_n((ptr), (val), __ATOMIC_##order)
+#define UN_ATOMIC_FETCH_ADD(ptr, val) \
+    __atomic_fetch_add((ptr), (val), __ATOMIC_SEQ_CST)
+#define UN_ATOMIC_CAS(ptr, expected, desired)                              \
+    __atomic_compare_exchange_n((ptr), (expected), (desired), false, \
+                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+#else  // defined(__GNUC__) || defined(__clang__)
+// #warning "ignoring atomicity, shared engines are not thread safe"
+#define UN_ATOMIC_LOAD(ptr, order) (*(ptr))
+#define UN_ATOMIC_STORE(ptr, val, order) (*(ptr) = (val))
+#define UN_ATOMIC_FETCH_ADD(ptr, val) ((*(ptr) += (val)) - (val))
+#define UN_ATOMIC_CAS(ptr, expected, desired) \
+    ((*(ptr) == *(expected)) ? (*(ptr) = (desired), true) : false)
+#endif  // defined(__GNUC__) || defined(__clang__)
+
 #ifdef NDEBUG
 #define DEBUG 0
 #else  // NDEBUG
@@ -98,6 +131,106 @@ static inline void *memalign_or_die(size_t alignment, size_t size) {
     return ptr;
 }
 
+// Arrays may live in memory mapped from a snapshot rather than in the heap.
+// Such arrays are copied rather than reallocated, and are never freed. Each
+// container that may hold them points to the Mapping of its engine's
+// snapshot, so that ownership is decided without any shared state.
+typedef struct {
+    const char *begin;
+    const char *end;
+} Mapping;
+
+static inline bool is_mapped(const Mapping *mapping, const void *ptr) {
+    return mapping && mapping->begin <= (const char *)ptr &&
+           (const char *)ptr < mapping->end;
+}
+
+static inline void free_owned(const Mapping *mapping, void *ptr) {
+    if (ptr && !is_mapped(mapping, ptr)) free(ptr);
+}
+
+// Like realloc_or_die, but also accepts mapped arrays of old_size bytes.
+static inline void *realloc_owned(const Mapping *mapping, void *ptr,
+                                  size_t old_size, size_t size) {
+    if (!ptr || !is_mapped(mapping, ptr)) return realloc_or_die(ptr, size);
+    void *result = malloc_or_die(size);
+    memcpy(result, ptr, old_size < size ? old_size : size);
+    return result;
+}
+
+// Large arrays are mapped directly rather than taken from the heap, so that
+// they are returned to the OS when freed and are backed by huge pages where
+// the OS allows. Building with -DHSTAR_HUGETLB first tries explicit huge
+// pages, which must be reserved by the administrator. Mapped pages stay
+// untouched until first written, so on NUMA machines each page lands on the
+// node of the thread that first writes it, not of the thread that mapped it.
+#define UN_MAP_MIN_BYTES (1UL << 16U)  // Smaller arrays come from the heap.
+#define UN_HUGE_PAGE_BYTES (1UL << 21U)
+// Huge pages pay off once an array outgrows the reach of the TLB with small
+// pages. Below that, faulting them in costs more than it saves.
+#define UN_HUGE_MIN_BYTES (1UL << 26U)
+
+static inline size_t round_up_to_huge_pages(size_t bytes) {
+    return (bytes + UN_HUGE_PAGE_BYTES - 1UL) & ~(UN_HUGE_PAGE_BYTES - 1UL);
+}
+
+// Reserves address space for bytes, a multiple of UN_HUGE_PAGE_BYTES,
+// committing none of it. Returns NULL if the OS refuses.
+static void *reserve_pages(size_t bytes) {
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void *ptr = MAP_FAILED;
+#if defined(HSTAR_HUGETLB) && defined(MAP_HUGETLB)
+    // Huge pages are reserved up front, so that a short pool fails here
+    // rather than faulting on first touch.
+    ptr = mmap(NULL, bytes, PROT_NONE, flags | MAP_HUGETLB, -1, 0);
+#endif  // defined(HSTAR_HUGETLB) && defined(MAP_HUGETLB)
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(NULL, bytes, PROT_NONE, flags | MAP_NORESERVE, -1, 0);
+    }
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+// Commits the first bytes of a reservation whose first old_bytes are
+// already committed. Committed pages read as zero until written.
+static void commit_pages(void *ptr, size_t old_bytes, size_t bytes) {
+    old_bytes = round_up_to_huge_pages(old_bytes);
+    bytes = round_up_to_huge_pages(bytes);
+    if (bytes <= old_bytes) return;
+    const int info = mprotect((char *)ptr + old_bytes, bytes - old_bytes,
+                              PROT_READ | PROT_WRITE);
+    UN_CHECK(!info, "out of memory, size = %zu", bytes);
+#if defined(MADV_HUGEPAGE)
+    if (bytes >= UN_HUGE_MIN_BYTES) {
+        madvise(ptr, bytes, MADV_HUGEPAGE);  // Only a hint, so errors are ok.
+    }
+#endif  // defined(MADV_HUGEPAGE)
+}
+
+// Allocates a zeroed array aligned to a cache line, freed by free_pages.
+static void *alloc_pages_or_die(size_t bytes) {
+    if (bytes < UN_MAP_MIN_BYTES) {
+        void *ptr = memalign_or_die(UN_CACHE_LINE_BYTES, bytes);
+        bzero(ptr, bytes);
+        return ptr;
+    }
+    void *ptr = reserve_pages(round_up_to_huge_pages(bytes));
+    UN_CHECK(ptr, "out of memory, size = %zu", bytes);
+    commit_pages(ptr, 0UL, bytes);
+    return ptr;
+}
+
+// Frees an array of bytes from alloc_pages_or_die, a reservation of bytes
+// from reserve_pages, or a heap array if bytes is 0. Arrays mapped from a
+// snapshot are never freed.
+static void free_pages(const Mapping *mapping, void *ptr, size_t bytes) {
+    if (!ptr || is_mapped(mapping, ptr)) return;
+    if (bytes < UN_MAP_MIN_BYTES) {
+        free(ptr);
+    } else {
+        munmap(ptr, round_up_to_huge_pages(bytes));
+    }
+}
+
 // Adapted from
 // https://github.com/google/farmhash/blob/master/src/farmhash.h#L167
 static inline uint64_t hash_64(uint64_t key) {
@@ -111,10 +244,46 @@ static inline uint64_t hash_64(uint64_t key) {
     return b;
 }
 
+// Counter-based random bits, in the style of SplitMix: the n-th draw of a
+// stream is a hash of its key and n, so a stream is reproduced exactly by
+// any thread that knows its key and how many draws have been made.
+static inline uint64_t random_draw(uint64_t key, uint64_t n) {
+    return hash_64(key + (n + 1UL) * 0x9e3779b97f4a7c15ULL);
+}
+
 static inline bool is_power_of_2(uint64_t x) {
     return ((x != 0UL) && !(x & (x - 1UL)));
 }
 
+static inline uint64_t round_up_to_power_of_2(uint64_t x) {
+    uint64_t result = 1UL;
+    while (result < x) result *= 2UL;
+    return result;
+}
+
+// Returns the index of the least significant set bit. Requires x != 0.
+static inline uint32_t ctz_32(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctz(x);
+#else   // defined(__GNUC__) || defined(__clang__)
+    uint32_t result = 0;
+    while (!(x & 1U)) {
+        x >>= 1U;
+        ++result;
+    }
+    return result;
+#endif  // defined(__GNUC__) || defined(__clang__)
+}
+
+// Hints that memory will soon be read.
+static inline void prefetch(const void *ptr) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(ptr, 0, 3);
+#else   // defined(__GNUC__) || defined(__clang__)
+    (void)ptr;
+#endif  // defined(__GNUC__) || defined(__clang__)
+}
+
 // ---------------------------------------------------------------------------
 // Signature
 
@@ -125,59 +294,650 @@ static inline bool is_power_of_2(uint64_t x) {
 #define UN_B 5U
 #define UN_C 6U
 #define UN_S 7U
-#define UN_VARS_BEGIN 8U
+#define UN_J 8U  // J x y is the join of x and y.
+#define UN_VARS_BEGIN 9U
 #define UN_VARS_END (UN_VARS_BEGIN + 32U)
 
+// Native booleans, operators and bytes follow the variables. Booleans act
+// as Church booleans and bytes as Church numerals, while operators run on
+// native args as CPU arithmetic. Native ints are allocated on demand above
+// UN_CONSTANTS_END, and hash-consed by value.
+#define UN_TRUE (UN_VARS_END + 0U)
+#define UN_FALSE (UN_VARS_END + 1U)
+#define UN_ADD (UN_VARS_END + 2U)
+#define UN_SUB (UN_VARS_END + 3U)
+#define UN_MUL (UN_VARS_END + 4U)
+#define UN_DIV (UN_VARS_END + 5U)
+#define UN_MOD (UN_VARS_END + 6U)
+#define UN_EQ (UN_VARS_END + 7U)
+#define UN_LT (UN_VARS_END + 8U)
+#define UN_BYTES_BEGIN (UN_VARS_END + 9U)
+#define UN_BYTES_END (UN_BYTES_BEGIN + 256U)
+#define UN_CONSTANTS_END UN_BYTES_END  // Obs below are never freed.
+
 static inline bool is_var(Ob ob) {
     return UN_VARS_BEGIN <= ob && ob < UN_VARS_END;
 }
 
+static inline bool is_byte(Ob ob) {
+    return UN_BYTES_BEGIN <= ob && ob < UN_BYTES_END;
+}
+
+static inline bool is_bool(Ob ob) { return ob == UN_TRUE || ob == UN_FALSE; }
+
+static inline bool is_operator(Ob ob) { return UN_ADD <= ob && ob <= UN_LT; }
+
+// ---------------------------------------------------------------------------
+// Statistics
+//
+// Hot paths count events in Counters private to each thread, which are
+// summed when read. Each counter has a single writer, so counting uses
+// relaxed loads and stores rather than atomic read-modify-writes. Building
+// with -DHSTAR_NO_STATS compiles counting out.
+
+#ifdef HSTAR_NO_STATS
+#define UN_STATS 0
+#else  // HSTAR_NO_STATS
+#define UN_STATS 1
+#endif  // HSTAR_NO_STATS
+
+typedef struct Counters {
+    uint64_t reductions[UN_VARS_BEGIN];  // By head atom, with natives at 0.
+    uint64_t memo_hits;
+    uint64_t memo_misses;
+    // Hash probes by floor(log2(lines visited)).
+    uint64_t find_probes[UN_STATS_PROBE_BUCKETS];
+    uint64_t insert_probes[UN_STATS_PROBE_BUCKETS];
+    uint64_t hash_grows;
+    uint64_t hash_grow_ns;
+    uint64_t memo_evictions;
+    struct Counters *next;  // In g_counters.
+} Counters;
+
+static pthread_mutex_t g_counters_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Counters *g_counters = NULL;  // Of live threads.
+static Counters g_counters_retired;  // Summed from exited threads.
+static pthread_key_t g_counters_key;
+static pthread_once_t g_counters_once = PTHREAD_ONCE_INIT;
+static _Thread_local Counters *t_counters = NULL;
+
+static inline void counter_add(uint64_t *sum, const uint64_t *counter) {
+    *sum += UN_ATOMIC_LOAD(counter, RELAXED);
+}
+
+static void Counters_add(Counters *sum, const Counters *counters) {
+    for (size_t i = 0; i != UN_VARS_BEGIN; ++i) {
+        counter_add(sum->reductions + i, counters->reductions + i);
+    }
+    counter_add(&sum->memo_hits, &counters->memo_hits);
+    counter_add(&sum->memo_misses, &counters->memo_misses);
+    for (size_t i = 0; i != UN_STATS_PROBE_BUCKETS; ++i) {
+        counter_add(sum->find_probes + i, counters->find_probes + i);
+        counter_add(sum->insert_probes + i, counters->insert_probes + i);
+    }
+    counter_add(&sum->hash_grows, &counters->hash_grows);
+    counter_add(&sum->hash_grow_ns, &counters->hash_grow_ns);
+    counter_add(&sum->memo_evictions, &counters->memo_evictions);
+}
+
+// Folds an exiting thread's counters into g_counters_retired.
+static void Counters_retire(void *arg) {
+    Counters *counters = arg;
+    pthread_mutex_lock(&g_counters_mutex);
+    Counters_add(&g_counters_retired, counters);
+    for (Counters **pos = &g_counters; *pos; pos = &(*pos)->next) {
+        if (*pos == counters) {
+            *pos = counters->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_counters_mutex);
+    free(counters);
+    t_counters = NULL;
+}
+
+static void Counters_init_key(void) {
+    UN_CHECK(!pthread_key_create(&g_counters_key, Counters_retire),
+             "failed to create key");
+}
+
+static Counters *Counters_register(void) {
+    pthread_once(&g_counters_once, Counters_init_key);
+    Counters *counters = calloc(1, sizeof(Counters));
+    UN_CHECK(counters, "out of memory, size = %zu", sizeof(Counters));
+    UN_CHECK(!pthread_setspecific(g_counters_key, counters),
+             "failed to set key");
+    pthread_mutex_lock(&g_counters_mutex);
+    counters->next = g_counters;
+    g_counters = counters;
+    pthread_mutex_unlock(&g_counters_mutex);
+    t_counters = counters;
+    return counters;
+}
+
+static inline Counters *Counters_local(void) {
+    Counters *counters = t_counters;
+    return likely(counters) ? counters : Counters_register();
+}
+
+// Sums the counters of all threads, live or exited.
+static void Counters_sum(Counters *sum) {
+    bzero(sum, sizeof(Counters));
+    pthread_mutex_lock(&g_counters_mutex);
+    Counters_add(sum, &g_counters_retired);
+    for (const Counters *c = g_counters; c; c = c->next) Counters_add(sum, c);
+    pthread_mutex_unlock(&g_counters_mutex);
+    sum->next = NULL;
+}
+
+// Counts into given Counters, which loops should fetch once.
+#define UN_COUNT_INTO(counters, field, n)                           \
+    do {                                                            \
+        if (UN_STATS) {                                             \
+            uint64_t *counter_ = &(counters)->field;                \
+            UN_ATOMIC_STORE(counter_,                               \
+                            UN_ATOMIC_LOAD(counter_, RELAXED) + (n), \
+                            RELAXED);                               \
+        }                                                           \
+    } while (0)
+#define UN_COUNT(field, n) UN_COUNT_INTO(Counters_local(), field, n)
+
+// Returns the histogram bucket of a probe that visited lines >= 1 lines.
+static inline size_t probe_bucket(size_t lines) {
+    size_t bucket = 0;
+    while ((lines >>= 1UL) && bucket + 1UL != UN_STATS_PROBE_BUCKETS) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+#define UN_COUNT_PROBES(field, lines) UN_COUNT(field[probe_bucket(lines)], 1U)
+
+static inline uint64_t monotonic_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000UL + (uint64_t)time.tv_nsec;
+}
+
 // ---------------------------------------------------------------------------
 // AbsList
+//
+// Most lists hold one or two entries, so these are stored inline. Longer
+// lists are stored in blocks of power-of-2 capacity, allocated from slabs
+// in size classes and recycled through per-class free lists. Blocks too
+// large for any class are allocated individually.
+
+#define UN_ABS_INLINE 2U
+#define UN_ABS_MIN_CAPACITY 4U
+#define UN_ABS_CLASSES 8U  // Capacities 4, 8, ..., 512.
+#define UN_ABS_SLAB_BYTES (64UL << 10UL)
+#define UN_ABS_OUTLINE 0xFFFFFFFFU  // Never a valid ob.
 
 typedef struct {
     Ob key;
     Ob val;
 } AbsList_Node;
 
-// zero is valid and initialized.
 typedef struct {
-    AbsList_Node *nodes;
-    size_t size;
+    void *free_lists[UN_ABS_CLASSES];  // Each block begins with its next.
+    void *slabs;                       // Each slab begins with its next.
+    char *slab_pos;
+    char *slab_end;
+    const Mapping *mapping;  // Of a snapshot holding blocks, if any.
+} AbsArena;
+
+static void AbsArena_clear(AbsArena *arena) {
+    while (arena->slabs) {
+        void *slab = arena->slabs;
+        memcpy(&arena->slabs, slab, sizeof(void *));
+        free(slab);
+    }
+    bzero(arena, sizeof(AbsArena));
+}
+
+static inline uint32_t AbsArena_class(size_t capacity) {
+    UN_DCHECK_TRUE(is_power_of_2(capacity));
+    return ctz_32((uint32_t)(capacity / UN_ABS_MIN_CAPACITY));
+}
+
+static void *AbsArena_alloc(AbsArena *arena, size_t capacity) {
+    const size_t bytes = capacity * sizeof(AbsList_Node);
+    const uint32_t size_class = AbsArena_class(capacity);
+    if (size_class >= UN_ABS_CLASSES) return malloc_or_die(bytes);
+    void *block = arena->free_lists[size_class];
+    if (block) {
+        memcpy(arena->free_lists + size_class, block, sizeof(void *));
+        return block;
+    }
+    if (unlikely((size_t)(arena->slab_end - arena->slab_pos) < bytes)) {
+        char *slab = malloc_or_die(UN_ABS_SLAB_BYTES);
+        memcpy(slab, &arena->slabs, sizeof(void *));
+        arena->slabs = slab;
+        arena->slab_pos = slab + UN_CACHE_LINE_BYTES;
+        arena->slab_end = slab + UN_ABS_SLAB_BYTES;
+    }
+    block = arena->slab_pos;
+    arena->slab_pos += bytes;
+    return block;
+}
+
+// Blocks may also live in a mapped snapshot, but never in another arena.
+static void AbsArena_free(AbsArena *arena, void *block, size_t capacity) {
+    const uint32_t size_class = AbsArena_class(capacity);
+    if (size_class >= UN_ABS_CLASSES) {
+        free_owned(arena->mapping, block);
+        return;
+    }
+    memcpy(block, arena->free_lists + size_class, sizeof(void *));
+    arena->free_lists[size_class] = block;
+}
+
+// Inline lists are terminated by a zero key if short. Outline lists are
+// marked by a tag in place of the last inline val. Zero is a valid empty
+// list.
+typedef union {
+    AbsList_Node inline_nodes[UN_ABS_INLINE];
+    struct {
+        AbsList_Node *nodes;
+        uint32_t size;
+        uint32_t tag;
+    } outline;
 } AbsList;
 
-static inline void AbsList_init(AbsList *list, size_t size) {
-    UN_DCHECK_TRUE(list->nodes == NULL);
-    UN_DCHECK_TRUE(list->size == 0UL);
-    list->nodes = malloc_or_die(size * sizeof(AbsList_Node));
-    list->size = size;
+static inline bool AbsList_is_inline(const AbsList *list) {
+    return list->outline.tag != UN_ABS_OUTLINE;
+}
+
+static inline size_t AbsList_size(const AbsList *list) {
+    if (!AbsList_is_inline(list)) return list->outline.size;
+    size_t size = 0;
+    while (size != UN_ABS_INLINE && list->inline_nodes[size].key) ++size;
+    return size;
 }
 
-static inline void AbsList_clear(AbsList *list) {
-    free(list->nodes);
+// Returns the capacity of an outline list.
+static inline size_t AbsList_capacity(size_t size) {
+    UN_DCHECK_LT((size_t)UN_ABS_INLINE, size, "zu");
+    return round_up_to_power_of_2(size < UN_ABS_MIN_CAPACITY
+                                      ? UN_ABS_MIN_CAPACITY
+                                      : size);
+}
+
+static inline AbsList_Node *AbsList_nodes(AbsList *list) {
+    return AbsList_is_inline(list) ? list->inline_nodes : list->outline.nodes;
+}
+
+static inline const AbsList_Node *AbsList_const_nodes(const AbsList *list) {
+    return AbsList_is_inline(list) ? list->inline_nodes : list->outline.nodes;
+}
+
+static inline void AbsList_clear(AbsList *list, AbsArena *arena) {
+    if (!AbsList_is_inline(list)) {
+        AbsArena_free(arena, list->outline.nodes,
+                      AbsList_capacity(list->outline.size));
+    }
     bzero(list, sizeof(AbsList));
 }
 
+// Returns the value for a key, or 0 if absent.
+static inline Ob AbsList_find(const AbsList *list, Ob key) {
+    const AbsList_Node *nodes = AbsList_const_nodes(list);
+    const size_t size = AbsList_size(list);
+    for (size_t i = 0; i != size; ++i) {
+        if (nodes[i].key == key) return nodes[i].val;
+    }
+    return 0U;
+}
+
+// Sets the value for a key, returning false if absent.
+static inline bool AbsList_set(AbsList *list, Ob key, Ob val) {
+    AbsList_Node *nodes = AbsList_nodes(list);
+    const size_t size = AbsList_size(list);
+    for (size_t i = 0; i != size; ++i) {
+        if (nodes[i].key == key) {
+            nodes[i].val = val;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline void AbsList_push(AbsList *list, AbsArena *arena, Ob key,
+                                Ob val) {
+    UN_DCHECK_TRUE(key && val);
+    const size_t size = AbsList_size(list);
+    if (size < UN_ABS_INLINE) {
+        list->inline_nodes[size].key = key;
+        list->inline_nodes[size].val = val;
+        return;
+    }
+    AbsList_Node *nodes = list->outline.nodes;
+    if (size == UN_ABS_INLINE) {
+        nodes = AbsArena_alloc(arena, UN_ABS_MIN_CAPACITY);
+        memcpy(nodes, list->inline_nodes, sizeof(list->inline_nodes));
+    } else if (size == AbsList_capacity(size)) {
+        nodes = AbsArena_alloc(arena, 2UL * size);
+        memcpy(nodes, list->outline.nodes, size * sizeof(AbsList_Node));
+        AbsArena_free(arena, list->outline.nodes, size);
+    }
+    nodes[size].key = key;
+    nodes[size].val = val;
+    list->outline.nodes = nodes;
+    list->outline.size = (uint32_t)(size + 1UL);
+    list->outline.tag = UN_ABS_OUTLINE;
+}
+
+static_assert(sizeof(AbsList) == 16, "AbsList has wrong size");
+
+static void AbsList_test(unsigned int seed) {
+    srand(seed);
+    enum { list_count = 16, max_size = 1500 };
+    AbsArena arena;
+    bzero(&arena, sizeof(AbsArena));
+    AbsList lists[list_count];
+    bzero(lists, sizeof(lists));
+    size_t sizes[list_count] = {0};
+    for (size_t step = 0; step != 20000UL; ++step) {
+        const size_t i = (size_t)rand() % list_count;
+        if (rand() % 200 == 0 || sizes[i] == max_size) {
+            AbsList_clear(lists + i, &arena);
+            sizes[i] = 0;
+        } else {
+            // Keys are 1, 2, ..., with vals derived from keys.
+            const Ob key = (Ob)++sizes[i];
+            AbsList_push(lists + i, &arena, key, key * 7U + (Ob)i);
+        }
+        UN_CHECK_EQ(AbsList_size(lists + i), sizes[i], "zu");
+        UN_CHECK_EQ(AbsList_is_inline(lists + i), sizes[i] <= UN_ABS_INLINE,
+                    "d");
+        for (Ob key = 1U; key <= sizes[i]; key += 1U + key / 16U) {
+            UN_CHECK_EQ(AbsList_find(lists + i, key), key * 7U + (Ob)i, "u");
+        }
+        UN_CHECK_EQ(AbsList_find(lists + i, (Ob)sizes[i] + 1U), 0U, "u");
+        UN_CHECK_TRUE(!AbsList_set(lists + i, (Ob)sizes[i] + 1U, 1U));
+        if (sizes[i]) {
+            const Ob key = 1U + (Ob)rand() % (Ob)sizes[i];
+            UN_CHECK_TRUE(AbsList_set(lists + i, key, key * 7U + 1U));
+            UN_CHECK_EQ(AbsList_find(lists + i, key), key * 7U + 1U, "u");
+            UN_CHECK_TRUE(AbsList_set(lists + i, key, key * 7U + (Ob)i));
+        }
+    }
+    for (size_t i = 0; i != list_count; ++i) AbsList_clear(lists + i, &arena);
+    AbsArena_clear(&arena);
+}
+
+// ---------------------------------------------------------------------------
+// Epoch
+//
+// Epoch-based reclamation of memory that lock-free readers may still be
+// reading. Readers bracket each access with Epoch_enter and Epoch_exit. The
+// single writer retires memory rather than freeing it, and retired memory is
+// freed once every reader that might have seen it has exited. Pointers to
+// retirable memory must be published and read with SEQ_CST, so that they are
+// ordered against the slot stores of Epoch_enter and loads of Epoch_collect.
+
+#define UN_EPOCH_SLOTS 256U
+
+typedef struct {
+    uint64_t epoch;  // Zero when the owning thread is not reading.
+    uint8_t padding[UN_CACHE_LINE_BYTES - sizeof(uint64_t)];
+} Epoch_Slot;
+static_assert(sizeof(Epoch_Slot) == UN_CACHE_LINE_BYTES,
+              "Epoch_Slot has wrong size");
+
+typedef struct {
+    void *ptr;
+    size_t bytes;  // As passed to free_pages.
+    uint64_t epoch;
+} Epoch_Retired;
+
+typedef struct {
+    Epoch_Slot slots[UN_EPOCH_SLOTS];
+    uint64_t epoch;
+    Epoch_Retired *retired;
+    size_t retired_size;
+    size_t retired_capacity;
+} Epoch;
+
+// Each thread takes a slot number on its first read, keeps it in every
+// Epoch, and gives it back on exit, when it is reading in none.
+static pthread_mutex_t g_epoch_slots_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t g_epoch_slots_used[UN_EPOCH_SLOTS / 32U];
+static pthread_key_t g_epoch_slot_key;
+static pthread_once_t g_epoch_slot_once = PTHREAD_ONCE_INIT;
+static _Thread_local uint32_t t_epoch_slot = 0;  // 1-based, 0 if unassigned.
+
+static void Epoch_release_slot(void *arg) {
+    const uint32_t index = (uint32_t)(uintptr_t)arg - 1U;
+    pthread_mutex_lock(&g_epoch_slots_mutex);
+    g_epoch_slots_used[index / 32U] &= ~(1U << (index % 32U));
+    pthread_mutex_unlock(&g_epoch_slots_mutex);
+    t_epoch_slot = 0;
+}
+
+static void Epoch_init_slot_key(void) {
+    UN_CHECK(!pthread_key_create(&g_epoch_slot_key, Epoch_release_slot),
+             "failed to create key");
+}
+
+// Assigns this thread a free slot, returning false if all are taken.
+static bool Epoch_acquire_slot(void) {
+    pthread_once(&g_epoch_slot_once, Epoch_init_slot_key);
+    uint32_t slot = 0;
+    pthread_mutex_lock(&g_epoch_slots_mutex);
+    for (uint32_t i = 0; i != UN_EPOCH_SLOTS / 32U; ++i) {
+        const uint32_t free_slots = ~g_epoch_slots_used[i];
+        if (!free_slots) continue;
+        const uint32_t bit = ctz_32(free_slots);
+        g_epoch_slots_used[i] |= 1U << bit;
+        slot = 1U + 32U * i + bit;
+        break;
+    }
+    pthread_mutex_unlock(&g_epoch_slots_mutex);
+    if (!slot) return false;
+    UN_CHECK(!pthread_setspecific(g_epoch_slot_key, (void *)(uintptr_t)slot),
+             "failed to set key");
+    t_epoch_slot = slot;
+    return true;
+}
+
+static Epoch *Epoch_new(void) {
+    Epoch *epoch = memalign_or_die(UN_CACHE_LINE_BYTES, sizeof(Epoch));
+    bzero(epoch, sizeof(Epoch));
+    epoch->epoch = 1UL;
+    return epoch;
+}
+
+static void Epoch_collect(Epoch *epoch) {
+    uint64_t min_active = UINT64_MAX;
+    for (uint32_t i = 0; i != UN_EPOCH_SLOTS; ++i) {
+        const uint64_t active = UN_ATOMIC_LOAD(&epoch->slots[i].epoch, SEQ_CST);
+        if (active && active < min_active) min_active = active;
+    }
+    size_t size = 0;
+    for (size_t i = 0; i != epoch->retired_size; ++i) {
+        if (epoch->retired[i].epoch < min_active) {
+            free_pages(NULL, epoch->retired[i].ptr, epoch->retired[i].bytes);
+        } else {
+            epoch->retired[size++] = epoch->retired[i];
+        }
+    }
+    epoch->retired_size = size;
+}
+
+// Frees ptr as by free_pages once no reader can see it. Must be called by
+// the writer, and never with mapped arrays.
+static void Epoch_retire(Epoch *epoch, void *ptr, size_t bytes) {
+    if (epoch->retired_size == epoch->retired_capacity) {
+        epoch->retired_capacity =
+            epoch->retired_capacity ? 2UL * epoch->retired_capacity : 8UL;
+        epoch->retired = realloc_or_die(
+            epoch->retired, epoch->retired_capacity * sizeof(Epoch_Retired));
+    }
+    epoch->retired[epoch->retired_size].ptr = ptr;
+    epoch->retired[epoch->retired_size].bytes = bytes;
+    epoch->retired[epoch->retired_size].epoch =
+        UN_ATOMIC_FETCH_ADD(&epoch->epoch, 1UL);
+    ++(epoch->retired_size);
+    Epoch_collect(epoch);
+}
+
+// Waits until every other reader that entered before the call has exited.
+// Must be called by the writer, which may itself be in a read section, as a
+// driver of parallel workers is. Readers never block, so this does not.
+static void Epoch_synchronize(Epoch *epoch) {
+    const uint64_t now = UN_ATOMIC_FETCH_ADD(&epoch->epoch, 1UL) + 1UL;
+    for (uint32_t i = 0; i != UN_EPOCH_SLOTS; ++i) {
+        if (i + 1U == t_epoch_slot) continue;
+        const uint64_t *active = &epoch->slots[i].epoch;
+        for (uint64_t e = UN_ATOMIC_LOAD(active, SEQ_CST); e && e < now;
+             e = UN_ATOMIC_LOAD(active, SEQ_CST)) {
+            sched_yield();
+        }
+    }
+}
+
+// Releases an array as by free_pages, waiting for readers if epoch is set.
+static void retire_pages(Epoch *epoch, const Mapping *mapping, void *ptr,
+                         size_t bytes) {
+    if (!ptr || is_mapped(mapping, ptr)) return;
+    if (epoch) {
+        Epoch_retire(epoch, ptr, bytes);
+    } else {
+        free_pages(NULL, ptr, bytes);
+    }
+}
+
+static void Epoch_delete(Epoch *epoch) {
+    for (size_t i = 0; i != epoch->retired_size; ++i) {
+        free_pages(NULL, epoch->retired[i].ptr, epoch->retired[i].bytes);
+    }
+    free(epoch->retired);
+    free(epoch);
+}
+
+// Returns false if every slot is held by another live thread, in which case
+// this thread must not read.
+static inline bool Epoch_enter(Epoch *epoch) {
+    if (unlikely(!t_epoch_slot) && !Epoch_acquire_slot()) return false;
+    Epoch_Slot *slot = epoch->slots + (t_epoch_slot - 1U);
+    UN_ATOMIC_STORE(&slot->epoch, UN_ATOMIC_LOAD(&epoch->epoch, RELAXED),
+                    SEQ_CST);
+    return true;
+}
+
+static inline void Epoch_exit(Epoch *epoch) {
+    UN_ATOMIC_STORE(&epoch->slots[t_epoch_slot - 1U].epoch, 0UL, RELEASE);
+}
+
+static void *Epoch_test_read(void *arg) {
+    Epoch *epoch = arg;
+    UN_CHECK(Epoch_enter(epoch), "no free slot");
+    Epoch_exit(epoch);
+    return NULL;
+}
+
+// Checks that exited threads give back their slots.
+static void Epoch_test(unsigned int seed) {
+    UN_UNUSED(seed);
+    Epoch *epoch = Epoch_new();
+    for (uint32_t i = 0; i != 2U * UN_EPOCH_SLOTS; ++i) {
+        pthread_t thread;
+        UN_CHECK(!pthread_create(&thread, NULL, Epoch_test_read, epoch),
+                 "pthread_create failed");
+        pthread_join(thread, NULL);
+    }
+    Epoch_delete(epoch);
+}
+
 // ---------------------------------------------------------------------------
 // Carrier
+//
+// Nodes live in a reservation of address space, whose pages are committed
+// as the carrier grows. A reservation has room for UN_CARRIER_RESERVE_GROWTH
+// times the capacity it was made for, so growth copies nodes only on the
+// rare doublings that outgrow it, and small engines reserve little. Where
+// the OS refuses to reserve, nodes live on the heap and growth copies them.
+
+#define UN_CARRIER_MAX_NODES (1UL << 31U)
+#define UN_CARRIER_MIN_RESERVE (1UL << 16U)  // In nodes, 2MiB.
+#define UN_CARRIER_RESERVE_GROWTH (1UL << 8U)
 
 typedef struct {
-    Ob obs[2];  // Either {next} if free or {lhs, rhs} if allocated.
-    AbsList abs;
+    Ob obs[2];  // Either {next} if free, {lhs, rhs} if an app, {0, value}
+                // if a native int, or {0, 0} if a constant.
+    AbsList abs;    // Abstractions of this ob, by variable.
+    uint32_t vars;  // Free variables, with bit i set iff x_i occurs.
 } Carrier_Node;
 
 typedef struct {
     Carrier_Node *nodes;
     Ob free_range;
     Ob free_list;
+    Ob free_count;  // Length of free_list.
     Ob capacity;
+    size_t reserved;  // Bytes reserved for nodes, or 0 if on the heap.
+    Epoch *epoch;     // Set iff shared with concurrent readers.
+    AbsArena abs_arena;
+    const Mapping *mapping;  // Of a snapshot holding nodes, if any.
 } Carrier;
 
+// Returns zeroed nodes for capacity obs, setting *reserved as for Carrier.
+static Carrier_Node *Carrier_new_nodes(size_t capacity, size_t *reserved) {
+    size_t max_nodes = capacity * UN_CARRIER_RESERVE_GROWTH;
+    if (max_nodes < UN_CARRIER_MIN_RESERVE) max_nodes = UN_CARRIER_MIN_RESERVE;
+    if (max_nodes > UN_CARRIER_MAX_NODES) max_nodes = UN_CARRIER_MAX_NODES;
+    const size_t bytes =
+        round_up_to_huge_pages(max_nodes * sizeof(Carrier_Node));
+    Carrier_Node *nodes = reserve_pages(bytes);
+    if (likely(nodes)) {
+        commit_pages(nodes, 0UL, capacity * sizeof(Carrier_Node));
+        *reserved = bytes;
+        return nodes;
+    }
+    nodes = calloc(capacity, sizeof(Carrier_Node));
+    UN_CHECK(nodes, "out of memory, size = %zu", capacity);
+    *reserved = 0UL;
+    return nodes;
+}
+
 static void Carrier_init(Carrier *carrier, size_t capacity) {
-    carrier->free_range = 1U;
+    UN_CHECK_LT(0UL, capacity, "zu");
+    UN_CHECK_LT(capacity, UN_CARRIER_MAX_NODES, "zu");
+    carrier->free_range = 1U;  // Position 0 is disallowed.
     carrier->free_list = 0U;
-    carrier->capacity = capacity - 1;  // Position 0 is disallowed.
-    carrier->nodes = malloc_or_die(capacity * sizeof(Ob));
+    carrier->free_count = 0U;
+    carrier->capacity = capacity;
+    carrier->nodes = Carrier_new_nodes(capacity, &carrier->reserved);
+    carrier->epoch = NULL;
+    bzero(&carrier->abs_arena, sizeof(AbsArena));
+    carrier->mapping = NULL;
+}
+
+// Reads a node, possibly concurrently with Carrier_alloc. Nodes of apps are
+// never modified after they are published, so the obs of a node are safe to
+// read even if the nodes array is replaced.
+static inline const Carrier_Node *Carrier_node(const Carrier *carrier, Ob ob) {
+    return UN_ATOMIC_LOAD(&carrier->nodes, SEQ_CST) + ob;
+}
+
+// Returns whether an allocated ob is a native int.
+static inline bool Carrier_is_int(const Carrier *carrier, Ob ob) {
+    return ob >= UN_CONSTANTS_END && !Carrier_node(carrier, ob)->obs[0];
+}
+
+static inline int32_t Carrier_int_value(const Carrier *carrier, Ob ob) {
+    UN_DCHECK(Carrier_is_int(carrier, ob), "not an int: %u", ob);
+    return (int32_t)Carrier_node(carrier, ob)->obs[1];
+}
+
+static void Carrier_clear(Carrier *carrier) {
+    for (Ob ob = 1U; ob < carrier->free_range; ++ob) {
+        AbsList_clear(&carrier->nodes[ob].abs, &carrier->abs_arena);
+    }
+    AbsArena_clear(&carrier->abs_arena);
+    free_pages(carrier->mapping, carrier->nodes, carrier->reserved);
+    bzero(carrier, sizeof(Carrier));
 }
 
 static Ob Carrier_alloc(Carrier *carrier) {
@@ -187,15 +947,34 @@ static Ob Carrier_alloc(Carrier *carrier) {
         if (ob) {
             carrier->free_list = carrier->nodes[ob].obs[0];
             carrier->nodes[ob].obs[0] = 0;
+            --carrier->free_count;
             return ob;
         }
     }
     // Maybe allocate more space.
     if (unlikely(carrier->free_range == carrier->capacity)) {
-        carrier->capacity *= 2UL;
-        carrier->nodes = realloc_or_die(carrier->nodes, carrier->capacity);
-        bzero(carrier->nodes + carrier->free_range,
-              carrier->free_range * sizeof(Ob));
+        UN_CHECK_LT((size_t)carrier->capacity, UN_CARRIER_MAX_NODES, "zu");
+        const size_t old_bytes = carrier->capacity * sizeof(Carrier_Node);
+        size_t capacity = carrier->capacity * 2UL;
+        if (capacity > UN_CARRIER_MAX_NODES) capacity = UN_CARRIER_MAX_NODES;
+        carrier->capacity = capacity;
+        const size_t bytes = capacity * sizeof(Carrier_Node);
+        if (likely(bytes <= carrier->reserved)) {
+            commit_pages(carrier->nodes, old_bytes, bytes);
+        } else {
+            // Move heap, snapshot or outgrown nodes into a new reservation
+            // if possible. Readers may still hold the old array, so copy it.
+            size_t reserved;
+            Carrier_Node *nodes = Carrier_new_nodes(capacity, &reserved);
+            memcpy(nodes, carrier->nodes,
+                   carrier->free_range * sizeof(Carrier_Node));
+            Carrier_Node *old_nodes = carrier->nodes;
+            const size_t old_reserved = carrier->reserved;
+            UN_ATOMIC_STORE(&carrier->nodes, nodes, SEQ_CST);
+            carrier->reserved = reserved;
+            retire_pages(carrier->epoch, carrier->mapping, old_nodes,
+                         old_reserved);
+        }
     }
     return carrier->free_range++;
 }
@@ -204,10 +983,11 @@ static void Carrier_free(Carrier *carrier, Ob ob) {
     UN_DCHECK_TRUE(0U < ob);
     UN_DCHECK_TRUE(ob < carrier->free_range);
     Carrier_Node *node = carrier->nodes + ob;
-    AbsList_clear(&node->abs);
+    AbsList_clear(&node->abs, &carrier->abs_arena);
     bzero(node, sizeof(Carrier_Node));
     node->obs[0] = carrier->free_list;
     carrier->free_list = ob;
+    ++carrier->free_count;
 }
 
 static void Carrier_test(unsigned int seed) {
@@ -236,23 +1016,76 @@ static void Carrier_test(unsigned int seed) {
         Carrier_free(&carrier, 3);
         Carrier_free(&carrier, 1);
         Carrier_free(&carrier, 2);
+        UN_CHECK_EQ(carrier.free_count, 3U, "u");
         ob = Carrier_alloc(&carrier);
         UN_CHECK_EQ(ob, 2U, "u");
+        UN_CHECK_EQ(carrier.free_count, 2U, "u");
         Carrier_free(&carrier, 2);
         ob = Carrier_alloc(&carrier);
         UN_CHECK_EQ(ob, 2U, "u");
-        Carrier_free(&carrier, 1);
         ob = Carrier_alloc(&carrier);
         UN_CHECK_EQ(ob, 1U, "u");
+        ob = Carrier_alloc(&carrier);
+        UN_CHECK_EQ(ob, 3U, "u");
         Carrier_free(&carrier, 3);
         ob = Carrier_alloc(&carrier);
         UN_CHECK_EQ(ob, 3U, "u");
+        ob = Carrier_alloc(&carrier);
+        UN_CHECK_EQ(ob, 5U, "u");
         Carrier_free(&carrier, 5);
+
+        Carrier_clear(&carrier);
+    }
+
+    // Reserved nodes grow in place, until they outgrow their reservation.
+    Carrier carrier;
+    Carrier_init(&carrier, 1UL);
+    const Carrier_Node *nodes = carrier.nodes;
+    for (Ob ob = 1U; ob != 1U << 16U; ++ob) {
+        UN_CHECK_EQ(Carrier_alloc(&carrier), ob, "u");
+        carrier.nodes[ob].obs[1] = ob;
+    }
+    if (carrier.reserved) UN_CHECK(carrier.nodes == nodes, "nodes moved");
+    for (Ob ob = 1U << 16U; ob != 1U << 18U; ++ob) {
+        UN_CHECK_EQ(Carrier_alloc(&carrier), ob, "u");
+        carrier.nodes[ob].obs[1] = ob;
     }
+    if (carrier.reserved) {
+        UN_CHECK_LE(carrier.capacity * sizeof(Carrier_Node), carrier.reserved,
+                    "zu");
+    }
+    for (Ob ob = 1U; ob != 1U << 18U; ++ob) {
+        UN_CHECK_EQ(carrier.nodes[ob].obs[1], ob, "u");
+        UN_CHECK_EQ(carrier.nodes[ob].obs[0], 0U, "u");
+    }
+    Carrier_clear(&carrier);
 }
 
 // ---------------------------------------------------------------------------
 // Hash
+//
+// This is an open-addressed table probed one 64-byte line (four 16-byte
+// nodes) at a time. Each probe sequence starts on a line boundary and all four
+// keys in a line are compared at once. The first node of each line carries an
+// overflow count of keys that were displaced past the line; a lookup that
+// fails to match in a line with zero overflow count is a miss, so misses stop
+// after one line at typical load factors. Because of this, a key never needs
+// to be followed by a tombstone when it is erased.
+//
+// Growth is incremental, so that no insert pays for rehashing the whole
+// table. Hash_grow installs an array of twice the size and keeps the old
+// array live, and each later insert migrates a few of its lines, so that
+// migration finishes long before the next grow. Until then, lookups that
+// miss the new array probe the old one.
+//
+// Large arrays are mapped, as by alloc_pages_or_die, but unlike Carrier
+// nodes they are not reserved to grow in place: a grown array rehashes every
+// key to new positions, so entries move on growth whatever the allocator,
+// and node pointers are valid only until the next insert.
+//
+// Hash_find_shared may run concurrently with a single writer: keys are
+// published after their values, and when a Hash has an Epoch, arrays
+// replaced by Hash_grow are retired rather than freed.
 
 typedef struct {
     Ob lhs;
@@ -275,6 +1108,12 @@ static inline uint64_t Word_hash(Word word) { return hash_64(word.uint64s[0]); }
 
 typedef union {
     Word key;
+    struct {
+        Word key;
+        Ob val;
+        uint8_t spare[3];
+        uint8_t overflow;  // Only meaningful in the first node of a line.
+    } slot;
     uint8_t uint8s[16];
     uint16_t uint16s[8];
     uint32_t uint32s[4];
@@ -282,68 +1121,272 @@ typedef union {
 } Hash_Node;
 static_assert(sizeof(Hash_Node) == 16, "Hash_Node has wrong size");
 
+#define UN_HASH_LINE_SIZE (UN_CACHE_LINE_BYTES / sizeof(Hash_Node))
+#define UN_HASH_LINE_MASK (~(uint64_t)(UN_HASH_LINE_SIZE - 1UL))
+#define UN_HASH_OVERFLOW_MAX (0xFFU)  // Saturated counts are never decreased.
+static_assert(UN_HASH_LINE_SIZE == 4, "Hash line has wrong size");
+
+#define UN_HASH_MIGRATE_LINES (2UL)  // Old lines migrated per insert.
+#define UN_HASH_MIGRATE_SAMPLE (64UL)  // Inserts per timed migration step.
+#define UN_HASH_REFERENCED 0  // Index in spare of the CLOCK reference bit.
+#define UN_HASH_EVICT_STEPS (32UL)  // Second chances given per eviction.
+
 typedef struct {
     Hash_Node *nodes;
     size_t mask;
-    size_t count;
+    size_t count;  // Including entries not yet migrated.
     size_t size;
+    Epoch *epoch;  // Set iff shared with concurrent readers.
+    // While growing, entries not yet migrated remain in old_nodes, an array
+    // of half the size whose lines below migrated have been emptied.
+    Hash_Node *old_nodes;
+    size_t old_count;
+    size_t migrated;
+    // A bounded Hash is a cache: rather than grow beyond max_size nodes, it
+    // evicts entries whose reference bit the clock hand finds clear.
+    size_t max_size;  // Zero if unbounded.
+    size_t clock;
+    const Mapping *mapping;  // Of a snapshot holding nodes, if any.
 } Hash;
 
 static void Hash_validate(const Hash *hash) {
     UN_CHECK_TRUE(is_power_of_2(hash->size));
+    UN_CHECK_LE(UN_HASH_LINE_SIZE, hash->size, "lu")
     UN_CHECK_LT(hash->count, hash->size, "lu")
     UN_CHECK_EQ(hash->mask, hash->size - 1UL, "lu")
     UN_CHECK_TRUE(hash->nodes);
+    if (hash->old_nodes) {
+        UN_CHECK_LE(hash->old_count, hash->count, "lu")
+        UN_CHECK_LT(hash->migrated, hash->size / 2UL, "lu")
+    }
+    if (hash->max_size) UN_CHECK_LE(hash->size, hash->max_size, "lu")
+    UN_CHECK_LT(hash->clock, hash->size, "lu")
 }
 
 static void Hash_init(Hash *hash, size_t size) {
     UN_CHECK(is_power_of_2(size), "expected size a power of 2, actual %zu",
              size);
-    const size_t bytes = sizeof(Hash_Node) * size;
-    hash->nodes = memalign_or_die(UN_CACHE_LINE_BYTES, bytes);
-    bzero(hash->nodes, bytes);
+    UN_CHECK(size >= UN_HASH_LINE_SIZE, "expected size >= %lu, actual %zu",
+             UN_HASH_LINE_SIZE, size);
+    hash->nodes = alloc_pages_or_die(sizeof(Hash_Node) * size);
     hash->mask = size - 1UL;
     hash->count = 0;
     hash->size = size;
+    hash->epoch = NULL;
+    hash->old_nodes = NULL;
+    hash->old_count = 0;
+    hash->migrated = 0;
+    hash->max_size = 0;
+    hash->clock = 0;
+    hash->mapping = NULL;
     if (DEBUG) Hash_validate(hash);
 }
 
+static void Hash_clear(Hash *hash) {
+    free_pages(hash->mapping, hash->nodes, sizeof(Hash_Node) * hash->size);
+    free_pages(hash->mapping, hash->old_nodes,
+               sizeof(Hash_Node) * hash->size / 2UL);
+    bzero(hash, sizeof(Hash));
+}
+
+// Returns a view of the old array while growing, as a Hash of its own.
+static inline Hash Hash_old(const Hash *hash) {
+    UN_DCHECK_TRUE(hash->old_nodes);
+    Hash old = {.nodes = hash->old_nodes,
+                .mask = hash->mask >> 1U,
+                .count = hash->old_count,
+                .size = hash->size / 2UL,
+                .mapping = hash->mapping};
+    return old;
+}
+
+static inline bool Hash_is_old(const Hash *hash, const Hash_Node *node) {
+    return hash->old_nodes && hash->old_nodes <= node &&
+           node < hash->old_nodes + hash->size / 2UL;
+}
+
 static inline Hash_Node *Hash_insert_nogrow(Hash *hash,
                                             const Hash_Node *node_to_insert);
+static void Hash_erase(Hash *hash, Hash_Node *node);
+
+// Moves up to line_count lines of the old array into the new array,
+// releasing the old array once it is empty. Per-insert steps are cheap next
+// to reading the clock, so only one step in UN_HASH_MIGRATE_SAMPLE is timed,
+// and counted for all of them.
+static void Hash_migrate(Hash *hash, size_t line_count) {
+    if (likely(!hash->old_nodes)) return;
+    const bool finishing = line_count > UN_HASH_MIGRATE_LINES;
+    const size_t step =
+        hash->migrated / (UN_HASH_LINE_SIZE * UN_HASH_MIGRATE_LINES);
+    const bool timed =
+        UN_STATS && (finishing || !(step % UN_HASH_MIGRATE_SAMPLE));
+    const uint64_t start_ns = timed ? monotonic_ns() : 0UL;
+    Hash old = Hash_old(hash);
+    for (; line_count && hash->migrated != old.size; --line_count) {
+        Hash_Node *line = old.nodes + hash->migrated;
+        for (size_t i = 0; i != UN_HASH_LINE_SIZE; ++i) {
+            if (!line[i].key.uint64s[0]) continue;
+            // Insert before erasing, so that concurrent readers can only
+            // miss an entry spuriously, as they may anyway.
+            Hash_insert_nogrow(hash, line + i);
+            --(hash->count);  // It was counted in the old array.
+            Hash_erase(&old, line + i);
+        }
+        hash->migrated += UN_HASH_LINE_SIZE;
+    }
+    hash->old_count = old.count;
+    if (hash->migrated == old.size) {
+        UN_DCHECK_EQ(old.count, 0UL, "zu");
+        UN_ATOMIC_STORE(&hash->old_nodes, NULL, SEQ_CST);
+        retire_pages(hash->epoch, hash->mapping, old.nodes,
+                     sizeof(Hash_Node) * old.size);
+    }
+    if (timed) {
+        const uint64_t weight = finishing ? 1UL : UN_HASH_MIGRATE_SAMPLE;
+        UN_COUNT(hash_grow_ns, (monotonic_ns() - start_ns) * weight);
+    }
+}
 
+// Completes any incremental growth, so that every entry is in nodes.
+static void Hash_finish_grow(Hash *hash) { Hash_migrate(hash, SIZE_MAX); }
+
+// Starts growing to twice the size. The caller migrates the old entries.
 static void Hash_grow(Hash *hash) {
+    Hash_finish_grow(hash);
+    const uint64_t start_ns = UN_STATS ? monotonic_ns() : 0UL;
     Hash grown;
     Hash_init(&grown, hash->size * 2UL);
-    for (Hash_Node *node = hash->nodes, *end = node + hash->size; node != end;
-         ++node) {
-        if (node->key.uint64s[0]) {
-            Hash_insert_nogrow(&grown, node);
-        }
-    }
-    free(hash->nodes);
-    memcpy(hash, &grown, sizeof(Hash));
+    // Publish the old array before the new one, then nodes before mask, so
+    // that concurrent readers never pair the larger mask with the smaller
+    // array, and may always find old entries at half the mask they read.
+    hash->old_count = hash->count;
+    hash->migrated = 0;
+    UN_ATOMIC_STORE(&hash->old_nodes, hash->nodes, SEQ_CST);
+    UN_ATOMIC_STORE(&hash->nodes, grown.nodes, SEQ_CST);
+    UN_ATOMIC_STORE(&hash->mask, grown.mask, SEQ_CST);
+    hash->size = grown.size;
+    UN_COUNT(hash_grows, 1U);
+    UN_COUNT(hash_grow_ns, monotonic_ns() - start_ns);
 }
 
+// Returns the position of the first node in the key's home line.
 static inline uint64_t Hash_bucket(const Hash *hash, Word key) {
-    return Word_hash(key) & hash->mask & 0xFFFFFFFCUL;
+    return Word_hash(key) & hash->mask & UN_HASH_LINE_MASK;
 }
 
-// Returns pointer if found, else NULL.
-static Hash_Node *Hash_find(const Hash *hash, Word key) {
+// Returns a bitmask of the nodes in a line whose key equals the given key.
+static inline uint32_t Hash_Line_match(const Hash_Node *line, Word key) {
+#if defined(__AVX2__)
+    const __m256i k = _mm256_set1_epi64x((int64_t)key.uint64s[0]);
+    const __m256i lo = _mm256_load_si256((const __m256i *)line);
+    const __m256i hi = _mm256_load_si256((const __m256i *)(line + 2));
+    // Keys occupy the even 64-bit lanes; odd lanes hold values.
+    const uint32_t mask_lo = (uint32_t)_mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(lo, k)));
+    const uint32_t mask_hi = (uint32_t)_mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(hi, k)));
+    const uint32_t mask = mask_lo | (mask_hi << 4U);
+    return (mask & 1U) | ((mask >> 1U) & 2U) | ((mask >> 2U) & 4U) |
+           ((mask >> 3U) & 8U);
+#elif defined(__SSE2__)
+    const __m128i k = _mm_set1_epi64x((int64_t)key.uint64s[0]);
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i != UN_HASH_LINE_SIZE; ++i) {
+        const __m128i n = _mm_load_si128((const __m128i *)(line + i));
+        const uint32_t eq = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi32(n, k));
+        mask |= ((eq & 0xFFU) == 0xFFU) << i;
+    }
+    return mask;
+#else   // defined(__AVX2__)
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i != UN_HASH_LINE_SIZE; ++i) {
+        mask |= (line[i].key.uint64s[0] == key.uint64s[0]) << i;
+    }
+    return mask;
+#endif  // defined(__AVX2__)
+}
+
+// Prefetches the home line of a key. This may be called concurrently with
+// one writer.
+static inline void Hash_prefetch(const Hash *hash, Word key) {
+    const size_t mask = UN_ATOMIC_LOAD(&hash->mask, RELAXED);
+    const Hash_Node *nodes = UN_ATOMIC_LOAD(&hash->nodes, RELAXED);
+    prefetch(nodes + (Word_hash(key) & mask & UN_HASH_LINE_MASK));
+}
+
+// Returns pointer if found in nodes, else NULL.
+static Hash_Node *Hash_probe(const Hash *hash, Word key) {
+    UN_DCHECK_TRUE(key.uint64s[0]);
     uint64_t pos = Hash_bucket(hash, key);
-    Hash_Node *node = hash->nodes + pos;
-    UN_DCHECK_LT(hash->count, hash->size, "zu")  // Required for termination.
-    while (key.uint64s[0] != node->uint64s[0]) {
-        if (!(node->uint64s[0])) return NULL;
-        pos = (pos + 1UL) & hash->mask;
-        node = hash->nodes + pos;
+    // When every line has overflowed, a miss visits every line once.
+    const size_t line_count = hash->size / UN_HASH_LINE_SIZE;
+    for (size_t lines = line_count; lines; --lines) {
+        Hash_Node *line = hash->nodes + pos;
+        const uint32_t match = Hash_Line_match(line, key);
+        if (likely(match)) {
+            UN_COUNT_PROBES(find_probes, line_count - lines + 1UL);
+            return line + ctz_32(match);
+        }
+        if (likely(!line->slot.overflow)) {
+            UN_COUNT_PROBES(find_probes, line_count - lines + 1UL);
+            return NULL;
+        }
+        pos = (pos + UN_HASH_LINE_SIZE) & hash->mask;
+    }
+    UN_COUNT_PROBES(find_probes, line_count);
+    return NULL;
+}
+
+// Returns pointer if found, else NULL. Finds do not migrate entries, so the
+// pointer remains valid until the next insert.
+static Hash_Node *Hash_find(const Hash *hash, Word key) {
+    Hash_Node *node = Hash_probe(hash, key);
+    if (likely(node || !hash->old_nodes)) return node;
+    const Hash old = Hash_old(hash);
+    return Hash_probe(&old, key);
+}
+
+// Marks a node as recently used. The bit is stored only when clear, so that
+// hits on hot entries do not keep dirtying their lines. This may be called
+// concurrently with one writer.
+static inline void Hash_touch(Hash_Node *node) {
+    uint8_t *bit = node->slot.spare + UN_HASH_REFERENCED;
+    if (!UN_ATOMIC_LOAD(bit, RELAXED)) UN_ATOMIC_STORE(bit, 1U, RELAXED);
+}
+
+// Erases one entry of a bounded Hash, by the CLOCK policy: the hand sweeps
+// nodes, giving each referenced entry a second chance by clearing its bit,
+// and evicts the first entry found unreferenced. Readers may set bits again
+// behind the hand, so no number of laps is sure to find one. Instead, after
+// UN_HASH_EVICT_STEPS second chances this evicts the entry under the hand,
+// which the hand passed longest ago.
+static void Hash_evict(Hash *hash) {
+    UN_DCHECK_TRUE(hash->count);
+    Hash_finish_grow(hash);
+    for (size_t steps = 0;; hash->clock = (hash->clock + 1UL) & hash->mask) {
+        Hash_Node *node = hash->nodes + hash->clock;
+        if (!node->key.uint64s[0]) continue;
+        uint8_t *bit = node->slot.spare + UN_HASH_REFERENCED;
+        if (UN_ATOMIC_LOAD(bit, RELAXED) && steps++ != UN_HASH_EVICT_STEPS) {
+            UN_ATOMIC_STORE(bit, 0U, RELAXED);
+            continue;
+        }
+        Hash_erase(hash, node);
+        hash->clock = (hash->clock + 1UL) & hash->mask;
+        UN_COUNT(memo_evictions, 1U);
+        return;
     }
-    return node;
 }
 
 static Hash_Node *Hash_insert(Hash *hash, const Hash_Node *node) {
+    Hash_migrate(hash, UN_HASH_MIGRATE_LINES);
     if (unlikely(hash->count * 2UL == hash->size)) {
-        Hash_grow(hash);
+        if (hash->max_size && hash->size >= hash->max_size) {
+            Hash_evict(hash);
+        } else {
+            Hash_grow(hash);
+            Hash_migrate(hash, UN_HASH_MIGRATE_LINES);
+        }
     }
     return Hash_insert_nogrow(hash, node);
 }
@@ -351,107 +1394,543 @@ static Hash_Node *Hash_insert(Hash *hash, const Hash_Node *node) {
 // Returns pointer to inserted node. Assumes node is not already inserted.
 static inline Hash_Node *Hash_insert_nogrow(Hash *hash,
                                             const Hash_Node *node_to_insert) {
+    UN_DCHECK_TRUE(node_to_insert->key.uint64s[0]);
+    UN_DCHECK_LT(hash->count + 1UL, hash->size, "zu")  // For termination.
+    const Word empty = {.uint64s = {0}};
     uint64_t pos = Hash_bucket(hash, node_to_insert->key);
-    Hash_Node *node = hash->nodes + pos;
-    UN_DCHECK_LT(hash->count, hash->size, "zu")  // Required for termination.
-    while (node->uint64s[0]) {
-        UN_DCHECK_NE(node->uint64s[0], node_to_insert->uint64s[0], PRIu64)
-        pos = (pos + 1UL) & hash->mask;
-        node = hash->nodes + pos;
+    for (size_t lines = 1; true; ++lines) {
+        Hash_Node *line = hash->nodes + pos;
+        UN_DCHECK_TRUE(!Hash_Line_match(line, node_to_insert->key));
+        const uint32_t vacant = Hash_Line_match(line, empty);
+        if (likely(vacant)) {
+            Hash_Node *node = line + ctz_32(vacant);
+            // Preserve the line's overflow count, and publish the key last.
+            // The val is released too, so that a reader that acquires it
+            // from a reused node also sees the key erased before, and its
+            // recheck of the key cannot pair the new val with an old key.
+            UN_ATOMIC_STORE(&node->slot.val, node_to_insert->slot.val,
+                            RELEASE);
+            memcpy(node->slot.spare, node_to_insert->slot.spare,
+                   sizeof(node->slot.spare));
+            UN_ATOMIC_STORE(&node->key.uint64s[0],
+                            node_to_insert->key.uint64s[0], RELEASE);
+            ++(hash->count);
+            UN_COUNT_PROBES(insert_probes, lines);
+            return node;
+        }
+        if (line->slot.overflow != UN_HASH_OVERFLOW_MAX) {
+            const uint8_t overflow = line->slot.overflow;
+            UN_ATOMIC_STORE(&line->slot.overflow, overflow + 1U, RELAXED);
+        }
+        pos = (pos + UN_HASH_LINE_SIZE) & hash->mask;
     }
-    memcpy(node, node_to_insert, sizeof(Hash_Node));
-    ++(hash->count);
-    return node;
 }
 
-// ---------------------------------------------------------------------------
-// Inverse Hash
+// Erases a node previously returned by Hash_find or Hash_insert.
+static void Hash_erase(Hash *hash, Hash_Node *node) {
+    UN_DCHECK_TRUE(node->key.uint64s[0]);
+    if (unlikely(Hash_is_old(hash, node))) {
+        Hash old = Hash_old(hash);
+        Hash_erase(&old, node);
+        hash->old_count = old.count;
+        --(hash->count);
+        return;
+    }
+    const uint64_t end = (uint64_t)(node - hash->nodes) & UN_HASH_LINE_MASK;
+    for (uint64_t pos = Hash_bucket(hash, node->key); pos != end;
+         pos = (pos + UN_HASH_LINE_SIZE) & hash->mask) {
+        Hash_Node *line = hash->nodes + pos;
+        UN_DCHECK_TRUE(line->slot.overflow);
+        if (line->slot.overflow != UN_HASH_OVERFLOW_MAX) {
+            const uint8_t overflow = line->slot.overflow;
+            UN_ATOMIC_STORE(&line->slot.overflow, overflow - 1U, RELAXED);
+        }
+    }
+    // Unpublish the key first.
+    UN_ATOMIC_STORE(&node->key.uint64s[0], 0UL, RELAXED);
+    UN_ATOMIC_STORE(&node->slot.val, 0U, RELEASE);
+    bzero(node->slot.spare, sizeof(node->slot.spare));
+    --(hash->count);
+}
 
-// TODO
-typedef union {
-    Word key;
-    uint8_t uint8s[16];
-    uint16_t uint16s[8];
-    uint32_t uint32s[4];
-    uint64_t uint64s[2];
-} InverseHash_Node;
-static_assert(sizeof(InverseHash_Node) == 16, "Hash_Node has wrong size");
+static Hash_Node *Hash_probe_shared(Hash_Node *nodes, size_t mask, Word key,
+                                    Ob *val) {
+    uint64_t pos = Word_hash(key) & mask & UN_HASH_LINE_MASK;
+    const size_t line_count = (mask + 1UL) / UN_HASH_LINE_SIZE;
+    for (size_t lines = line_count; lines; --lines) {
+        Hash_Node *line = nodes + pos;
+        // Matches are validated atomically, since the line may be changing.
+        for (uint32_t match = Hash_Line_match(line, key); match;
+             match &= match - 1U) {
+            Hash_Node *node = line + ctz_32(match);
+            const uint64_t *node_key = &node->key.uint64s[0];
+            if (UN_ATOMIC_LOAD(node_key, ACQUIRE) != key.uint64s[0]) continue;
+            *val = UN_ATOMIC_LOAD(&node->slot.val, ACQUIRE);
+            if (*val && UN_ATOMIC_LOAD(node_key, RELAXED) == key.uint64s[0]) {
+                UN_COUNT_PROBES(find_probes, line_count - lines + 1UL);
+                return node;
+            }
+        }
+        if (!UN_ATOMIC_LOAD(&line->slot.overflow, RELAXED)) {
+            UN_COUNT_PROBES(find_probes, line_count - lines + 1UL);
+            return NULL;
+        }
+        pos = (pos + UN_HASH_LINE_SIZE) & mask;
+    }
+    UN_COUNT_PROBES(find_probes, line_count);
+    return NULL;
+}
 
-// TODO
-typedef struct {
-    InverseHash_Node *nodes;
-    size_t mask;
-    size_t count;
-    size_t size;
-} InverseHash;
+// Returns the node for a key and sets *val to its value, or returns NULL if
+// not found. This may be called concurrently with one writer, within an
+// Epoch read section when the Hash can grow or shrink. The node may be
+// reused by the writer at any time, so only its CLOCK bit may be written.
+// Misses may be spurious and should be retried by the writer.
+static Hash_Node *Hash_find_node_shared(const Hash *hash, Word key, Ob *val) {
+    UN_DCHECK_TRUE(key.uint64s[0]);
+    const size_t mask = UN_ATOMIC_LOAD(&hash->mask, SEQ_CST);
+    Hash_Node *nodes = UN_ATOMIC_LOAD(&hash->nodes, SEQ_CST);
+    if (unlikely(!nodes)) return NULL;  // Shrinking; see Hash_shrink.
+    Hash_Node *node = Hash_probe_shared(nodes, mask, key, val);
+    if (likely(node)) return node;
+    // An old array is at least as new as the mask, so half the mask is in
+    // bounds, though it may be too small to find the key.
+    Hash_Node *old_nodes = UN_ATOMIC_LOAD(&hash->old_nodes, SEQ_CST);
+    return old_nodes ? Hash_probe_shared(old_nodes, mask >> 1U, key, val)
+                     : NULL;
+}
+
+// Returns the value for a key, or 0 if not found, as Hash_find_node_shared.
+static Ob Hash_find_shared(const Hash *hash, Word key) {
+    Ob val;
+    return Hash_find_node_shared(hash, key, &val) ? val : 0U;
+}
+
+// Rebuilds a Hash at a smaller size, first evicting entries until they fit.
+static void Hash_shrink(Hash *hash, size_t size) {
+    UN_DCHECK_LT(size, hash->size, "zu");
+    Hash_finish_grow(hash);
+    while (hash->count * 2UL >= size) Hash_evict(hash);
+    Hash shrunk;
+    Hash_init(&shrunk, size);
+    for (size_t i = 0; i != hash->size; ++i) {
+        const Hash_Node *node = hash->nodes + i;
+        if (node->key.uint64s[0]) Hash_insert_nogrow(&shrunk, node);
+    }
+    Hash_Node *old_nodes = hash->nodes;
+    const size_t bytes = sizeof(Hash_Node) * hash->size;
+    if (hash->epoch) {
+        // Unlike growth, no order of publishing keeps a reader from pairing
+        // the old mask with the smaller array. So unpublish the array, under
+        // which readers miss, and publish the new one only after every
+        // reader that may have seen the old mask has exited.
+        UN_ATOMIC_STORE(&hash->nodes, NULL, SEQ_CST);
+        UN_ATOMIC_STORE(&hash->mask, shrunk.mask, SEQ_CST);
+        Epoch_synchronize(hash->epoch);
+        UN_ATOMIC_STORE(&hash->nodes, shrunk.nodes, SEQ_CST);
+    } else {
+        hash->nodes = shrunk.nodes;
+        hash->mask = shrunk.mask;
+    }
+    retire_pages(hash->epoch, hash->mapping, old_nodes, bytes);
+    hash->count = shrunk.count;
+    hash->size = size;
+    hash->clock = 0;
+}
+
+static void Hash_test(unsigned int seed) {
+    srand(seed);
+    for (size_t size = UN_HASH_LINE_SIZE; size <= 256UL; size *= 2UL) {
+        Hash hash;
+        Hash_init(&hash, size);
+        const Ob max_ob = 16U;
+        Ob vals[16U + 1U][16U + 1U];
+        bzero(vals, sizeof(vals));
+        for (Ob step = 1U; step <= 1000U; ++step) {
+            Ob lhs = 1U + (Ob)rand() % max_ob;
+            Ob rhs = 1U + (Ob)rand() % max_ob;
+            Word key = {.ob_pair = {lhs, rhs}};
+            Hash_Node *node = Hash_find(&hash, key);
+            UN_CHECK_EQ(node != NULL, vals[lhs][rhs] != 0U, "d");
+            if (node) {
+                UN_CHECK_EQ(node->slot.val, vals[lhs][rhs], "u");
+                if (rand() % 2) {
+                    Hash_erase(&hash, node);
+                    vals[lhs][rhs] = 0U;
+                }
+            } else if (hash.count + 1UL < hash.size) {
+                // Fill well beyond the usual load factor to force overflow.
+                Hash_Node node_to_insert = {.key = key};
+                node_to_insert.slot.val = step;
+                node = Hash_insert_nogrow(&hash, &node_to_insert);
+                vals[lhs][rhs] = node->slot.val;
+            }
+            if (DEBUG) Hash_validate(&hash);
+        }
+        size_t count = 0;
+        for (Ob lhs = 1U; lhs <= max_ob; ++lhs) {
+            for (Ob rhs = 1U; rhs <= max_ob; ++rhs) {
+                Word key = {.ob_pair = {lhs, rhs}};
+                const Hash_Node *node = Hash_find(&hash, key);
+                UN_CHECK_EQ(node != NULL, vals[lhs][rhs] != 0U, "d");
+                count += (node != NULL);
+            }
+        }
+        UN_CHECK_EQ(count, hash.count, "zu");
+        Hash_clear(&hash);
+    }
+
+    // Check that growth preserves entries, including those erased while
+    // they wait in the old array.
+    enum { max_ob = 1000 };
+    bool present[max_ob + 1];
+    bzero(present, sizeof(present));
+    Hash hash;
+    Hash_init(&hash, UN_HASH_LINE_SIZE);
+    size_t growing_steps = 0;
+    for (Ob ob = 1U; ob <= max_ob; ++ob) {
+        Hash_Node node_to_insert = {.key = {.ob_pair = {ob, ob}}};
+        node_to_insert.slot.val = ob;
+        Hash_insert(&hash, &node_to_insert);
+        present[ob] = true;
+        growing_steps += hash.old_nodes != NULL;
+        const Ob other = 1U + (Ob)rand() % ob;
+        Word key = {.ob_pair = {other, other}};
+        Hash_Node *node = Hash_find(&hash, key);
+        UN_CHECK_EQ(node != NULL, present[other], "d");
+        UN_CHECK_EQ(Hash_find_shared(&hash, key), present[other] ? other : 0U,
+                    "u");
+        if (node && rand() % 4 == 0) {
+            Hash_erase(&hash, node);
+            present[other] = false;
+        }
+        if (DEBUG) Hash_validate(&hash);
+    }
+    UN_CHECK(growing_steps, "growth was not incremental");
+    size_t count = 0;
+    for (Ob ob = 1U; ob <= max_ob; ++ob) {
+        Word key = {.ob_pair = {ob, ob}};
+        const Hash_Node *node = Hash_find(&hash, key);
+        UN_CHECK_EQ(node != NULL, present[ob], "d");
+        if (node) UN_CHECK_EQ(node->slot.val, ob, "u");
+        count += present[ob];
+    }
+    UN_CHECK_EQ(hash.count, count, "zu");
+    Hash_finish_grow(&hash);
+    UN_CHECK_EQ(hash.count, count, "zu");
+    UN_CHECK(!hash.old_nodes, "old array was not released");
+    Hash_clear(&hash);
+
+    // Check that a bounded hash evicts cold entries rather than growing,
+    // and keeps an entry that is touched between inserts.
+    Hash_init(&hash, UN_HASH_LINE_SIZE);
+    hash.max_size = 64UL;
+    const Word hot = {.ob_pair = {1U, 1U}};
+    for (Ob ob = 1U; ob <= max_ob; ++ob) {
+        Hash_Node node_to_insert = {.key = {.ob_pair = {ob, ob}}};
+        node_to_insert.slot.val = ob;
+        Hash_insert(&hash, &node_to_insert);
+        Ob val = 0U;
+        Hash_Node *node = Hash_find_node_shared(&hash, hot, &val);
+        UN_CHECK_EQ(val, 1U, "u");
+        Hash_touch(node);
+        if (DEBUG) Hash_validate(&hash);
+    }
+    UN_CHECK_EQ(hash.size, 64UL, "zu");
+    Hash_shrink(&hash, 16UL);
+    Hash_validate(&hash);
+    UN_CHECK_LT(hash.count, 8UL, "zu");
+    UN_CHECK_EQ(Hash_find_shared(&hash, hot), 1U, "u");
+    count = 0;
+    for (Ob ob = 1U; ob <= max_ob; ++ob) {
+        Word key = {.ob_pair = {ob, ob}};
+        const Hash_Node *node = Hash_find(&hash, key);
+        if (node) UN_CHECK_EQ(node->slot.val, ob, "u");
+        count += node != NULL;
+    }
+    UN_CHECK_EQ(hash.count, count, "zu");
+    Hash_clear(&hash);
+
+    // Check that eviction gives a bounded number of second chances, even
+    // when every entry is referenced.
+    Hash_init(&hash, 256UL);
+    hash.max_size = 256UL;
+    for (Ob ob = 1U; ob <= 100U; ++ob) {
+        Hash_Node node_to_insert = {.key = {.ob_pair = {ob, ob}}};
+        node_to_insert.slot.val = ob;
+        node_to_insert.slot.spare[UN_HASH_REFERENCED] = 1U;
+        Hash_insert(&hash, &node_to_insert);
+    }
+    Hash_evict(&hash);
+    UN_CHECK_EQ(hash.count, 99UL, "zu");
+    count = 0;
+    for (size_t i = 0; i != hash.size; ++i) {
+        count += hash.nodes[i].slot.spare[UN_HASH_REFERENCED];
+    }
+    UN_CHECK_EQ(count, 99UL - UN_HASH_EVICT_STEPS, "zu");
+    Hash_clear(&hash);
+}
 
 // ---------------------------------------------------------------------------
-// Structure
-// We need the following structure:
-// - app_LRv : Pair Ob -partial-> Ob
-// - app_Lrv : Ob -> List (Pair Ob)
-// - app_Rlv : Ob -> List (Pair Ob)
-// - app_Vlr : Ob -> List (Pair Ob)
-// - abs_LRv : Pair Ob -partial-> Ob
-// - abs_Lrv : Ob -> List (Pair Ob)
-// - abs_Vlr : Ob -> List (Pair Ob)
-// - reduced : Ob -partial-> Ob
-// - pending : ReprioritizableQueue Ob
+// Inverse Hash
+//
+// An InverseHash is a multimap Ob -> List (Pair Ob), used to index the app
+// table by lhs, rhs, or value. Each key owns a chain of 64-byte pages. Only
+// the head page of a chain is partially full, so insertion and removal touch
+// one page, and iterating over a key's pairs streams whole cache lines.
+
+#define UN_INVERSE_HASH_PAGE_SIZE 7U
 
 typedef struct {
-    Carrier carrier;
+    ObPair pairs[UN_INVERSE_HASH_PAGE_SIZE];
+    uint32_t next;  // Either the next page in a chain or the next free page.
+    uint32_t size;
+} InverseHash_Page;
+static_assert(sizeof(InverseHash_Page) == UN_CACHE_LINE_BYTES,
+              "InverseHash_Page has wrong size");
 
-    Hash hash;  // A shared associative array.
+typedef struct {
+    InverseHash_Page *pages;  // Position 0 is disallowed.
+    uint32_t *heads;          // Head page of each key, indexed by Ob.
+    size_t count;             // Total number of pairs.
+    Ob key_capacity;
+    uint32_t page_free_range;
+    uint32_t page_free_list;
+    uint32_t page_capacity;
+    const Mapping *mapping;  // Of a snapshot holding arrays, if any.
+} InverseHash;
 
-    InverseHash app_Lrv;
-    InverseHash app_Rlv;
-    InverseHash app_Vlr;
+static void InverseHash_init(InverseHash *inverse, size_t capacity) {
+    UN_CHECK_LT(0UL, capacity, "zu");
+    inverse->pages = memalign_or_die(UN_CACHE_LINE_BYTES,
+                                     capacity * sizeof(InverseHash_Page));
+    inverse->heads = calloc(capacity, sizeof(uint32_t));
+    UN_CHECK(inverse->heads, "out of memory, size = %zu", capacity);
+    inverse->count = 0;
+    inverse->key_capacity = capacity;
+    inverse->page_free_range = 1U;
+    inverse->page_free_list = 0U;
+    inverse->page_capacity = capacity;
+    inverse->mapping = NULL;
+}
 
-    Hash abs_LRv;
-} Structure;
+static void InverseHash_clear(InverseHash *inverse) {
+    free_owned(inverse->mapping, inverse->pages);
+    free_owned(inverse->mapping, inverse->heads);
+    bzero(inverse, sizeof(InverseHash));
+}
 
-void Structure_init(Structure *structure) {
-    Carrier_init(&structure->carrier, UN_INIT_CAPACITY);
-    Hash_init(&structure->hash, UN_INIT_CAPACITY);
+static void InverseHash_validate(const InverseHash *inverse) {
+    UN_CHECK_TRUE(inverse->pages);
+    UN_CHECK_TRUE(inverse->heads);
+    UN_CHECK_LE(inverse->page_free_range, inverse->page_capacity, "u");
+    size_t count = 0;
+    for (Ob key = 0; key != inverse->key_capacity; ++key) {
+        for (uint32_t page = inverse->heads[key]; page;
+             page = inverse->pages[page].next) {
+            UN_CHECK_LT(page, inverse->page_free_range, "u");
+            const uint32_t size = inverse->pages[page].size;
+            UN_CHECK_LT(0U, size, "u");
+            UN_CHECK_LE(size, UN_INVERSE_HASH_PAGE_SIZE, "u");
+            if (page != inverse->heads[key]) {
+                UN_CHECK_EQ(size, UN_INVERSE_HASH_PAGE_SIZE, "u");
+            }
+            count += size;
+        }
+    }
+    UN_CHECK_EQ(count, inverse->count, "zu");
+}
 
-    // Init constants.
-    Ob ob;
-    ob = Carrier_alloc(&structure->carrier);
-    UN_CHECK_EQ(ob, UN_TOP, "u");
-    ob = Carrier_alloc(&structure->carrier);
-    UN_CHECK_EQ(ob, UN_BOT, "u");
-    ob = Carrier_alloc(&structure->carrier);
-    UN_CHECK_EQ(ob, UN_I, "u");
-    ob = Carrier_alloc(&structure->carrier);
-    UN_CHECK_EQ(ob, UN_K, "u");
-    ob = Carrier_alloc(&structure->carrier);
-    UN_CHECK_EQ(ob, UN_B, "u");
-    ob = Carrier_alloc(&structure->carrier);
-    UN_CHECK_EQ(ob, UN_C, "u");
-    ob = Carrier_alloc(&structure->carrier);
-    UN_CHECK_EQ(ob, UN_S, "u");
+static uint32_t InverseHash_alloc_page(InverseHash *inverse) {
+    uint32_t page = inverse->page_free_list;
+    if (page) {
+        inverse->page_free_list = inverse->pages[page].next;
+        return page;
+    }
+    if (unlikely(inverse->page_free_range == inverse->page_capacity)) {
+        const size_t capacity = 2UL * inverse->page_capacity;
+        UN_CHECK_LT(capacity, 1UL << 32UL, "zu");
+        const size_t bytes = inverse->page_capacity * sizeof(InverseHash_Page);
+        InverseHash_Page *pages = memalign_or_die(
+            UN_CACHE_LINE_BYTES, capacity * sizeof(InverseHash_Page));
+        memcpy(pages, inverse->pages, bytes);
+        free_owned(inverse->mapping, inverse->pages);
+        inverse->pages = pages;
+        inverse->page_capacity = capacity;
+    }
+    return inverse->page_free_range++;
+}
 
-    // Init variables.
-    for (Ob var = UN_VARS_BEGIN; var != UN_VARS_END; ++var) {
-        ob = Carrier_alloc(&structure->carrier);
-        UN_CHECK_EQ(ob, var, "u");
-        Carrier_Node *node = structure->carrier.nodes + ob;
+static void InverseHash_grow_keys(InverseHash *inverse, Ob key) {
+    size_t capacity = inverse->key_capacity;
+    while (capacity <= key) capacity *= 2UL;
+    inverse->heads =
+        realloc_owned(inverse->mapping, inverse->heads,
+                      inverse->key_capacity * sizeof(uint32_t),
+                      capacity * sizeof(uint32_t));
+    bzero(inverse->heads + inverse->key_capacity,
+          (capacity - inverse->key_capacity) * sizeof(uint32_t));
+    inverse->key_capacity = capacity;
+}
 
-        // Set \x.x = I.
-        AbsList_init(&node->abs, 1);
-        node->abs.nodes[0].key = var;
-        node->abs.nodes[0].val = UN_I;
+// Adds a pair to a key's list. Does not check for duplicates.
+static void InverseHash_insert(InverseHash *inverse, Ob key, Ob lhs, Ob rhs) {
+    UN_DCHECK_TRUE(key);
+    if (unlikely(key >= inverse->key_capacity)) {
+        InverseHash_grow_keys(inverse, key);
+    }
+    uint32_t head = inverse->heads[key];
+    if (!head || inverse->pages[head].size == UN_INVERSE_HASH_PAGE_SIZE) {
+        const uint32_t page = InverseHash_alloc_page(inverse);
+        inverse->pages[page].next = head;
+        inverse->pages[page].size = 0U;
+        inverse->heads[key] = head = page;
     }
+    InverseHash_Page *page = inverse->pages + head;
+    page->pairs[page->size].lhs = lhs;
+    page->pairs[page->size].rhs = rhs;
+    ++(page->size);
+    ++(inverse->count);
+}
 
-    TODO("init other structure");
+// Removes one copy of a pair from a key's list. Returns whether it was found.
+static bool InverseHash_remove(InverseHash *inverse, Ob key, Ob lhs, Ob rhs) {
+    if (unlikely(key >= inverse->key_capacity)) return false;
+    const uint32_t head = inverse->heads[key];
+    if (!head) return false;
+    InverseHash_Page *head_page = inverse->pages + head;
+    for (uint32_t page = head; page; page = inverse->pages[page].next) {
+        ObPair *pairs = inverse->pages[page].pairs;
+        for (uint32_t i = 0, size = inverse->pages[page].size; i != size; ++i) {
+            if (pairs[i].lhs == lhs && pairs[i].rhs == rhs) {
+                // Fill the hole with the last pair of the head page.
+                pairs[i] = head_page->pairs[--(head_page->size)];
+                if (!head_page->size) {
+                    inverse->heads[key] = head_page->next;
+                    head_page->next = inverse->page_free_list;
+                    inverse->page_free_list = head;
+                }
+                --(inverse->count);
+                return true;
+            }
+        }
+    }
+    return false;
 }
 
-void Structure_validate(const Structure *structure) {
-    Hash_validate(&structure->hash);
+// Removes every pair of a key for which keep(pair, key, data) is false.
+static void InverseHash_filter(InverseHash *inverse, Ob key,
+                               bool (*keep)(const ObPair *, Ob, void *),
+                               void *data) {
+    if (unlikely(key >= inverse->key_capacity)) return;
+    for (uint32_t page = inverse->heads[key], next; page; page = next) {
+        InverseHash_Page *current = inverse->pages + page;
+        next = current->next;
+        uint32_t i = 0;
+        while (i < current->size) {
+            if (keep(current->pairs + i, key, data)) {
+                ++i;
+                continue;
+            }
+            // Fill the hole with the last pair of the head page, which has
+            // already been filtered.
+            const uint32_t head = inverse->heads[key];
+            InverseHash_Page *head_page = inverse->pages + head;
+            current->pairs[i] = head_page->pairs[--(head_page->size)];
+            --(inverse->count);
+            if (!head_page->size) {
+                inverse->heads[key] = head_page->next;
+                head_page->next = inverse->page_free_list;
+                inverse->page_free_list = head;
+            }
+        }
+    }
+}
+
+// Iterates over a key's pairs. Invalidated by any insertion or removal.
+typedef struct {
+    const InverseHash_Page *pages;
+    uint32_t page;
+    uint32_t pos;
+} InverseHash_Iter;
+
+static inline void InverseHash_Iter_init(InverseHash_Iter *iter,
+                                         const InverseHash *inverse, Ob key) {
+    iter->pages = inverse->pages;
+    iter->page = (key < inverse->key_capacity) ? inverse->heads[key] : 0U;
+    iter->pos = 0U;
 }
 
-// A single global instance.
-static Structure g_structure;
+// Returns the next pair, or NULL when done.
+static inline const ObPair *InverseHash_Iter_next(InverseHash_Iter *iter) {
+    while (iter->page) {
+        const InverseHash_Page *page = iter->pages + iter->page;
+        if (likely(iter->pos != page->size)) return page->pairs + iter->pos++;
+        iter->page = page->next;
+        iter->pos = 0U;
+    }
+    return NULL;
+}
+
+static bool InverseHash_test_keep(const ObPair *pair, Ob key, void *data) {
+    UN_UNUSED(key);
+    UN_UNUSED(data);
+    return pair->lhs % 2U;
+}
+
+static void InverseHash_test(unsigned int seed) {
+    srand(seed);
+    InverseHash inverse;
+    InverseHash_init(&inverse, 1UL);
+    enum { max_ob = 8 };
+    uint32_t counts[max_ob + 1][max_ob + 1][max_ob + 1];
+    bzero(counts, sizeof(counts));
+    for (size_t step = 0; step < 10000UL; ++step) {
+        Ob key = 1U + (Ob)rand() % max_ob;
+        Ob lhs = 1U + (Ob)rand() % max_ob;
+        Ob rhs = 1U + (Ob)rand() % max_ob;
+        if (rand() % 3) {
+            InverseHash_insert(&inverse, key, lhs, rhs);
+            ++counts[key][lhs][rhs];
+        } else {
+            bool removed = InverseHash_remove(&inverse, key, lhs, rhs);
+            UN_CHECK_EQ(removed, counts[key][lhs][rhs] != 0U, "d");
+            if (removed) --counts[key][lhs][rhs];
+        }
+    }
+    InverseHash_validate(&inverse);
+    for (Ob key = 1U; key <= max_ob; ++key) {
+        uint32_t found[max_ob + 1][max_ob + 1];
+        bzero(found, sizeof(found));
+        InverseHash_Iter iter;
+        InverseHash_Iter_init(&iter, &inverse, key);
+        for (const ObPair *pair; (pair = InverseHash_Iter_next(&iter));) {
+            ++found[pair->lhs][pair->rhs];
+        }
+        UN_CHECK_TRUE(!memcmp(found, counts[key], sizeof(found)));
+    }
+
+    // Filter out pairs with even lhs.
+    for (Ob key = 1U; key <= max_ob; ++key) {
+        InverseHash_filter(&inverse, key, InverseHash_test_keep, NULL);
+        for (Ob lhs = 2U; lhs <= max_ob; lhs += 2U) {
+            bzero(counts[key][lhs], sizeof(counts[key][lhs]));
+        }
+    }
+    InverseHash_validate(&inverse);
+    for (Ob key = 1U; key <= max_ob; ++key) {
+        for (Ob lhs = 1U; lhs <= max_ob; ++lhs) {
+            for (Ob rhs = 1U; rhs <= max_ob; ++rhs) {
+                while (counts[key][lhs][rhs]) {
+                    UN_CHECK_TRUE(InverseHash_remove(&inverse, key, lhs, rhs));
+                    --counts[key][lhs][rhs];
+                }
+            }
+        }
+    }
+    UN_CHECK_EQ(inverse.count, 0UL, "zu");
+    InverseHash_clear(&inverse);
+}
 
 // ---------------------------------------------------------------------------
 // ObStack
@@ -475,7 +1954,8 @@ static inline void ObStack_push(ObStack *stack, Ob ob) {
     if (unlikely(stack->size == stack->capacity)) {
         stack->capacity *= 2UL;
         UN_CHECK(stack->capacity, "stack is too large");
-        stack->data = realloc_or_die(stack->data, stack->capacity);
+        stack->data =
+            realloc_or_die(stack->data, stack->capacity * sizeof(Ob));
     }
     stack->data[stack->size++] = ob;
 }
@@ -484,129 +1964,4998 @@ static inline Ob ObStack_try_pop(ObStack *stack) {
     return stack->size ? stack->data[--stack->size] : 0U;
 }
 
+typedef struct {
+    Ob lhs;
+    Ob rhs;
+    Ob val;
+} App;
+
+// zero is valid and initialized.
+typedef struct {
+    App *data;
+    size_t size;
+    size_t capacity;
+} AppStack;
+
+static inline void AppStack_clear(AppStack *stack) {
+    free(stack->data);
+    bzero(stack, sizeof(AppStack));
+}
+
+static inline void AppStack_push(AppStack *stack, Ob lhs, Ob rhs, Ob val) {
+    if (unlikely(stack->size == stack->capacity)) {
+        stack->capacity = stack->capacity ? 2UL * stack->capacity : 16UL;
+        stack->data =
+            realloc_or_die(stack->data, stack->capacity * sizeof(App));
+    }
+    App *app = stack->data + stack->size++;
+    app->lhs = lhs;
+    app->rhs = rhs;
+    app->val = val;
+}
+
 // ---------------------------------------------------------------------------
-// Reduction algorithms
+// ObQueue
+//
+// A reprioritizable max-priority queue of obs, implemented as an indexed
+// 4-ary heap. Each ob's heap position is kept in a flat array indexed by Ob,
+// parallel to Carrier.nodes, so priorities can be raised or lowered in
+// O(log n) time.
 
-static inline Hash_Node *find_app(Ob lhs, Ob rhs) {
-    Word key = {.uint32s = {lhs, rhs}};
-    return Hash_find(&g_structure.hash, key);
+#define UN_QUEUE_ARITY 4U
+
+typedef struct {
+    Ob ob;
+    uint32_t priority;
+} ObQueue_Entry;
+
+typedef struct {
+    ObQueue_Entry *heap;
+    uint32_t *positions;  // 1-based heap position of each ob, 0 if absent.
+    uint32_t size;
+    uint32_t capacity;
+    Ob ob_capacity;
+    const Mapping *mapping;  // Of a snapshot holding arrays, if any.
+} ObQueue;
+
+static void ObQueue_init(ObQueue *queue, size_t capacity) {
+    UN_CHECK_LT(0UL, capacity, "zu");
+    queue->heap = malloc_or_die(capacity * sizeof(ObQueue_Entry));
+    queue->positions = calloc(capacity, sizeof(uint32_t));
+    UN_CHECK(queue->positions, "out of memory, size = %zu", capacity);
+    queue->size = 0U;
+    queue->capacity = capacity;
+    queue->ob_capacity = capacity;
+    queue->mapping = NULL;
 }
 
-static Ob make_app(Ob lhs, Ob rhs) {
-    UN_DCHECK_TRUE(lhs);
-    UN_DCHECK_TRUE(rhs);
-    UN_UNUSED(lhs);
-    UN_UNUSED(rhs);
-    TODO("")
+static void ObQueue_clear(ObQueue *queue) {
+    free_owned(queue->mapping, queue->heap);
+    free_owned(queue->mapping, queue->positions);
+    bzero(queue, sizeof(ObQueue));
 }
 
-static Ob simplify(Ob ob);
+static void ObQueue_validate(const ObQueue *queue) {
+    UN_CHECK_LE(queue->size, queue->capacity, "u");
+    for (uint32_t i = 0; i != queue->size; ++i) {
+        const Ob ob = queue->heap[i].ob;
+        UN_CHECK_LT(ob, queue->ob_capacity, "u");
+        UN_CHECK_EQ(queue->positions[ob], i + 1U, "u");
+        if (i) {
+            const uint32_t parent = (i - 1U) / UN_QUEUE_ARITY;
+            UN_CHECK_LE(queue->heap[i].priority, queue->heap[parent].priority,
+                        "u");
+        }
+    }
+}
 
-static Ob simplify_app(Ob lhs, Ob rhs) {
-    UN_DCHECK_TRUE(lhs);
-    UN_DCHECK_TRUE(rhs);
+static inline bool ObQueue_contains(const ObQueue *queue, Ob ob) {
+    return ob < queue->ob_capacity && queue->positions[ob];
+}
 
-    // First check cache.
-    {
-        const Hash_Node *node = find_app(lhs, rhs);
-        if (node) return node - g_structure.hash.nodes;
+static inline void ObQueue_place(ObQueue *queue, uint32_t pos,
+                                 ObQueue_Entry entry) {
+    queue->heap[pos] = entry;
+    queue->positions[entry.ob] = pos + 1U;
+}
+
+static void ObQueue_sift_up(ObQueue *queue, uint32_t pos) {
+    const ObQueue_Entry entry = queue->heap[pos];
+    while (pos) {
+        const uint32_t parent = (pos - 1U) / UN_QUEUE_ARITY;
+        if (queue->heap[parent].priority >= entry.priority) break;
+        ObQueue_place(queue, pos, queue->heap[parent]);
+        pos = parent;
     }
+    ObQueue_place(queue, pos, entry);
+}
 
-    // Linearly beta-eta reduce.
-    Ob head = lhs;
-    {
-        ObStack args;
-        ObStack_init(&args);
-        ObStack_push(&args, rhs);
-        while (!is_var(head)) {
-            const Carrier_Node *head_node = g_structure.carrier.nodes + head;
-            while (head_node->obs[0] && head_node->obs[1]) {
-                head = head_node->obs[0];
-                ObStack_push(&args, head_node->obs[1]);
-                head_node = g_structure.carrier.nodes + head;
-            }
-            switch (head) {
-                case UN_I:
-                    TODO("reduce");
-                    break;
-                default:
-                    UN_ERROR("uidentified ob: %u", head);
+static void ObQueue_sift_down(ObQueue *queue, uint32_t pos) {
+    const ObQueue_Entry entry = queue->heap[pos];
+    while (true) {
+        const uint32_t begin = pos * UN_QUEUE_ARITY + 1U;
+        if (begin >= queue->size) break;
+        const uint32_t end = (queue->size - begin < UN_QUEUE_ARITY)
+                                 ? queue->size
+                                 : begin + UN_QUEUE_ARITY;
+        uint32_t best = begin;
+        for (uint32_t child = begin + 1U; child < end; ++child) {
+            if (queue->heap[child].priority > queue->heap[best].priority) {
+                best = child;
             }
         }
+        if (queue->heap[best].priority <= entry.priority) break;
+        ObQueue_place(queue, pos, queue->heap[best]);
+        pos = best;
+    }
+    ObQueue_place(queue, pos, entry);
+}
+
+static void ObQueue_reserve(ObQueue *queue, size_t size, Ob max_ob) {
+    if (unlikely(size > queue->capacity)) {
+        size_t capacity = queue->capacity;
+        while (capacity < size) capacity *= 2UL;
+        queue->heap =
+            realloc_owned(queue->mapping, queue->heap,
+                          queue->size * sizeof(ObQueue_Entry),
+                          capacity * sizeof(ObQueue_Entry));
+        queue->capacity = capacity;
+    }
+    if (unlikely(max_ob >= queue->ob_capacity)) {
+        size_t capacity = queue->ob_capacity;
+        while (capacity <= max_ob) capacity *= 2UL;
+        queue->positions = realloc_owned(
+            queue->mapping, queue->positions,
+            queue->ob_capacity * sizeof(uint32_t),
+            capacity * sizeof(uint32_t));
+        bzero(queue->positions + queue->ob_capacity,
+              (capacity - queue->ob_capacity) * sizeof(uint32_t));
+        queue->ob_capacity = capacity;
+    }
+}
+
+// Inserts an ob or changes its priority if already present.
+static void ObQueue_push(ObQueue *queue, Ob ob, uint32_t priority) {
+    UN_DCHECK_TRUE(ob);
+    ObQueue_reserve(queue, queue->size + 1UL, ob);
+    uint32_t pos = queue->positions[ob];
+    if (pos) {
+        ObQueue_Entry *entry = queue->heap + (pos - 1U);
+        const uint32_t old_priority = entry->priority;
+        entry->priority = priority;
+        if (priority > old_priority) {
+            ObQueue_sift_up(queue, pos - 1U);
+        } else if (priority < old_priority) {
+            ObQueue_sift_down(queue, pos - 1U);
+        }
+    } else {
+        const ObQueue_Entry entry = {ob, priority};
+        ObQueue_place(queue, queue->size++, entry);
+        ObQueue_sift_up(queue, queue->size - 1U);
+    }
+}
 
-        // Simpilfy args.
-        Ob arg;
-        while ((arg = ObStack_try_pop(&args))) {
-            arg = simplify(arg);
-            head = make_app(head, arg);
+// Pushes many obs at once. When the batch is large relative to the queue,
+// this rebuilds the heap in linear time rather than sifting each entry.
+static void ObQueue_push_many(ObQueue *queue, const Ob *obs,
+                              const uint32_t *priorities, size_t count) {
+    if (count < 1UL + queue->size / UN_QUEUE_ARITY) {
+        for (size_t i = 0; i != count; ++i) {
+            ObQueue_push(queue, obs[i], priorities[i]);
+        }
+        return;
+    }
+    Ob max_ob = 0U;
+    for (size_t i = 0; i != count; ++i) {
+        if (obs[i] > max_ob) max_ob = obs[i];
+    }
+    ObQueue_reserve(queue, queue->size + count, max_ob);
+    for (size_t i = 0; i != count; ++i) {
+        UN_DCHECK_TRUE(obs[i]);
+        const uint32_t pos = queue->positions[obs[i]];
+        if (pos) {
+            queue->heap[pos - 1U].priority = priorities[i];
+        } else {
+            const ObQueue_Entry entry = {obs[i], priorities[i]};
+            ObQueue_place(queue, queue->size++, entry);
         }
-        ObStack_delete(&args);
     }
+    for (uint32_t pos = queue->size / UN_QUEUE_ARITY + 1U; pos--;) {
+        if (pos < queue->size) ObQueue_sift_down(queue, pos);
+    }
+}
 
-    // Abstract variables.
-    TODO("implement");
+// Returns an ob's priority, or 0 if absent.
+static inline uint32_t ObQueue_priority(const ObQueue *queue, Ob ob) {
+    return ObQueue_contains(queue, ob)
+               ? queue->heap[queue->positions[ob] - 1U].priority
+               : 0U;
+}
 
-    // Save value.
-    Hash_Node node_to_insert = {.uint32s = {lhs, rhs}};
-    const Hash_Node *node = Hash_insert(&g_structure.hash, &node_to_insert);
-    if (unlikely(!node)) return 0;
-    return node - g_structure.hash.nodes;
+static void ObQueue_remove(ObQueue *queue, Ob ob) {
+    if (!ObQueue_contains(queue, ob)) return;
+    const uint32_t pos = queue->positions[ob] - 1U;
+    queue->positions[ob] = 0U;
+    if (pos == --(queue->size)) return;
+    const uint32_t priority = queue->heap[pos].priority;
+    ObQueue_place(queue, pos, queue->heap[queue->size]);
+    if (queue->heap[pos].priority > priority) {
+        ObQueue_sift_up(queue, pos);
+    } else {
+        ObQueue_sift_down(queue, pos);
+    }
 }
 
-static Ob compute_app(Ob lhs, Ob rhs, int *budget) {
-    if (unlikely(!*budget)) return simplify_app(lhs, rhs);
-    UN_DCHECK_TRUE(lhs);
-    UN_DCHECK_TRUE(rhs);
-    TODO("implement");
-    return make_app(lhs, rhs);
+// Returns the ob of highest priority, or 0 if empty.
+static Ob ObQueue_try_pop(ObQueue *queue) {
+    if (!queue->size) return 0U;
+    const Ob ob = queue->heap[0].ob;
+    ObQueue_remove(queue, ob);
+    return ob;
 }
 
-static Ob simplify(Ob ob) {
-    const Ob lhs = g_structure.carrier.nodes[ob].obs[0];
-    const Ob rhs = g_structure.carrier.nodes[ob].obs[0];
-    return (lhs && rhs) ? simplify_app(lhs, rhs) : ob;
+static void ObQueue_test(unsigned int seed) {
+    srand(seed);
+    ObQueue queue;
+    ObQueue_init(&queue, 1UL);
+    enum { max_ob = 64 };
+    uint32_t expected[max_ob + 1];  // Priority + 1, or 0 if absent.
+    bzero(expected, sizeof(expected));
+    for (size_t step = 0; step < 10000UL; ++step) {
+        const Ob ob = 1U + (Ob)rand() % max_ob;
+        switch (rand() % 4) {
+            case 0: {
+                const uint32_t priority = (uint32_t)rand() % 100U;
+                ObQueue_push(&queue, ob, priority);
+                expected[ob] = priority + 1U;
+            } break;
+            case 1: {
+                ObQueue_remove(&queue, ob);
+                expected[ob] = 0U;
+            } break;
+            case 2: {
+                Ob obs[max_ob];
+                uint32_t priorities[max_ob];
+                const size_t count = 1UL + (size_t)rand() % max_ob;
+                for (size_t i = 0; i != count; ++i) {
+                    obs[i] = 1U + (Ob)rand() % max_ob;
+                    priorities[i] = (uint32_t)rand() % 100U;
+                    expected[obs[i]] = priorities[i] + 1U;
+                }
+                ObQueue_push_many(&queue, obs, priorities, count);
+            } break;
+            case 3: {
+                uint32_t max_priority = 0U;
+                for (Ob i = 1U; i <= max_ob; ++i) {
+                    if (expected[i] > max_priority) max_priority = expected[i];
+                }
+                const Ob popped = ObQueue_try_pop(&queue);
+                UN_CHECK_EQ(popped != 0U, max_priority != 0U, "d");
+                if (popped) {
+                    UN_CHECK_EQ(expected[popped], max_priority, "u");
+                    expected[popped] = 0U;
+                }
+            } break;
+        }
+        UN_CHECK_EQ(ObQueue_priority(&queue, ob) + ObQueue_contains(&queue, ob),
+                    expected[ob], "u");
+    }
+    ObQueue_validate(&queue);
+    ObQueue_clear(&queue);
 }
 
-static Ob compute(Ob ob, int *budget) {
-    const Ob lhs = g_structure.carrier.nodes[ob].obs[0];
-    const Ob rhs = g_structure.carrier.nodes[ob].obs[0];
-    return (lhs && rhs) ? compute_app(lhs, rhs, budget) : ob;
+// ---------------------------------------------------------------------------
+// UnionFind
+//
+// Equivalence classes of obs, as a forest over Carrier ids. An ob whose
+// parent is 0 represents its class.
+
+// zero is valid and initialized.
+typedef struct {
+    Ob *parents;
+    Ob capacity;
+    const Mapping *mapping;  // Of a snapshot holding parents, if any.
+} UnionFind;
+
+static void UnionFind_clear(UnionFind *union_find) {
+    free_owned(union_find->mapping, union_find->parents);
+    bzero(union_find, sizeof(UnionFind));
 }
 
-// -----------------------------------------------------------------------
-// Interface
+// Parents are accessed atomically, so that finds may run concurrently with
+// each other, but not with merges.
+static inline bool UnionFind_is_rep(const UnionFind *union_find, Ob ob) {
+    return ob >= union_find->capacity ||
+           !UN_ATOMIC_LOAD(union_find->parents + ob, RELAXED);
+}
 
-// Returns 0 on success.
-void un_init() {
-    static bool initialized = false;
-    if (unlikely(!initialized)) {
-        Structure_init(&g_structure);
-        initialized = true;
+// Returns the representative of an ob's class, compressing the path to it.
+static inline Ob UnionFind_find(UnionFind *union_find, Ob ob) {
+    if (likely(UnionFind_is_rep(union_find, ob))) return ob;
+    Ob *parents = union_find->parents;
+    Ob rep = UN_ATOMIC_LOAD(parents + ob, RELAXED);
+    while (!UnionFind_is_rep(union_find, rep)) {
+        rep = UN_ATOMIC_LOAD(parents + rep, RELAXED);
+    }
+    while (ob != rep) {
+        const Ob parent = UN_ATOMIC_LOAD(parents + ob, RELAXED);
+        UN_ATOMIC_STORE(parents + ob, rep, RELAXED);
+        ob = parent;
     }
+    return rep;
 }
 
-Ob un_simplify(Ob ob) {
-    UN_CHECK(ob, "ob is null");
-    return simplify(ob);
+// Merges the class of dep into the class of rep. Both must be reps.
+static void UnionFind_merge(UnionFind *union_find, Ob dep, Ob rep) {
+    UN_DCHECK_NE(dep, rep, "u");
+    UN_DCHECK_TRUE(UnionFind_is_rep(union_find, dep));
+    UN_DCHECK_TRUE(UnionFind_is_rep(union_find, rep));
+    if (unlikely(dep >= union_find->capacity)) {
+        size_t capacity = union_find->capacity ? union_find->capacity : 1UL;
+        while (capacity <= dep) capacity *= 2UL;
+        union_find->parents =
+            realloc_owned(union_find->mapping, union_find->parents,
+                          union_find->capacity * sizeof(Ob),
+                          capacity * sizeof(Ob));
+        bzero(union_find->parents + union_find->capacity,
+              (capacity - union_find->capacity) * sizeof(Ob));
+        union_find->capacity = capacity;
+    }
+    union_find->parents[dep] = rep;
 }
 
-Ob un_simplify_app(Ob lhs, Ob rhs) {
-    UN_CHECK(lhs, "lhs is null");
-    UN_CHECK(rhs, "rhs is null");
-    return simplify_app(lhs, rhs);
+static void UnionFind_test(unsigned int seed) {
+    srand(seed);
+    enum { max_ob = 64 };
+    Ob classes[max_ob + 1];  // A naive implementation.
+    for (Ob ob = 0; ob <= max_ob; ++ob) classes[ob] = ob;
+    UnionFind union_find = {NULL, 0, NULL};
+    for (size_t step = 0; step < 1000UL; ++step) {
+        const Ob lhs = 1U + (Ob)rand() % max_ob;
+        const Ob rhs = 1U + (Ob)rand() % max_ob;
+        const Ob lhs_rep = UnionFind_find(&union_find, lhs);
+        const Ob rhs_rep = UnionFind_find(&union_find, rhs);
+        UN_CHECK_EQ(lhs_rep == rhs_rep, classes[lhs] == classes[rhs], "d");
+        if (lhs_rep != rhs_rep && rand() % 4 == 0) {
+            UnionFind_merge(&union_find, lhs_rep, rhs_rep);
+            const Ob old_class = classes[lhs];
+            for (Ob ob = 1U; ob <= max_ob; ++ob) {
+                if (classes[ob] == old_class) classes[ob] = classes[rhs];
+            }
+        }
+    }
+    UnionFind_clear(&union_find);
 }
 
-Ob un_compute(Ob ob, int *budget) {
-    UN_CHECK(ob, "ob is null");
-    UN_CHECK(budget, "budget is null");
-    return compute(ob, budget);
+// ---------------------------------------------------------------------------
+// Machine
+//
+// The explicit stacks of reduction, reused across calls so that reduction
+// neither allocates in steady state nor recurses on the C stack. Each frame
+// simplifies one app, and owns a segment of the shared arg stack. A frame
+// first reduces its head, then simplifies its args.
+
+#define UN_FRAME_REDUCING 0xFFFFFFFFU  // An args_end while reducing the head.
+
+typedef struct {
+    Ob lhs;  // The app being simplified, memoized when done.
+    Ob rhs;
+    Ob head;
+    uint32_t args_begin;  // Args of this frame are args[begin, end).
+    uint32_t args_end;
+    uint32_t arg_pos;  // Args below arg_pos are simplified. While reducing,
+                       // the position of a forced arg, as in reduce_head.
+} Frame;
+
+typedef struct {
+    Frame *frames;
+    uint32_t frame_count;
+    uint32_t frame_capacity;
+    ObStack args;
+    bool sampling;  // Whether J chooses an arg, by draws from sample_key.
+    uint64_t sample_key;
+    uint64_t sample_draws;
+} Machine;
+
+static void Machine_init(Machine *machine) {
+    bzero(machine, sizeof(Machine));
+    machine->frame_capacity = UN_CACHE_LINE_BYTES / sizeof(Frame);
+    machine->frames = malloc_or_die(machine->frame_capacity * sizeof(Frame));
+    ObStack_init(&machine->args);
 }
 
-Ob un_compute_app(Ob lhs, Ob rhs, int *budget) {
-    UN_CHECK(lhs, "lhs is null");
-    UN_CHECK(rhs, "rhs is null");
-    UN_CHECK(budget, "budget is null");
-    return compute_app(lhs, rhs, budget);
+static void Machine_delete(Machine *machine) {
+    free(machine->frames);
+    ObStack_delete(&machine->args);
+}
+
+static inline Frame *Machine_push(Machine *machine) {
+    if (unlikely(machine->frame_count == machine->frame_capacity)) {
+        machine->frame_capacity *= 2U;
+        UN_CHECK(machine->frame_capacity, "stack is too large");
+        machine->frames = realloc_or_die(
+            machine->frames, machine->frame_capacity * sizeof(Frame));
+    }
+    return machine->frames + machine->frame_count++;
+}
+
+static inline Frame *Machine_top(Machine *machine) {
+    UN_DCHECK_TRUE(machine->frame_count);
+    return machine->frames + machine->frame_count - 1U;
+}
+
+// A suspended computation, holding the frames of a Machine above some base
+// and their args, rebased to begin at zero. Suspensions are linked into
+// their Structure so that garbage collection can see their obs.
+typedef struct Suspension {
+    Frame *frames;
+    uint32_t frame_count;
+    uint32_t arg_count;
+    Ob *args;
+    struct Suspension *prev;
+    struct Suspension *next;
+} Suspension;
+
+static void Suspension_link(Suspension **list, Suspension *suspension) {
+    suspension->prev = NULL;
+    suspension->next = *list;
+    if (*list) (*list)->prev = suspension;
+    *list = suspension;
+}
+
+static void Suspension_unlink(Suspension **list, Suspension *suspension) {
+    if (suspension->prev) {
+        suspension->prev->next = suspension->next;
+    } else {
+        *list = suspension->next;
+    }
+    if (suspension->next) suspension->next->prev = suspension->prev;
+    suspension->prev = suspension->next = NULL;
+}
+
+// Moves frames above base into a suspension, replacing its contents.
+static void Machine_suspend(Machine *machine, uint32_t base,
+                            Suspension *suspension) {
+    UN_DCHECK_LT(base, machine->frame_count, "u");
+    const uint32_t frame_count = machine->frame_count - base;
+    const uint32_t args_begin = machine->frames[base].args_begin;
+    const uint32_t arg_count = machine->args.size - args_begin;
+    suspension->frames =
+        realloc_or_die(suspension->frames, frame_count * sizeof(Frame));
+    suspension->args = realloc_or_die(suspension->args,
+                                      (arg_count ? arg_count : 1U) *
+                                          sizeof(Ob));
+    for (uint32_t i = 0; i != frame_count; ++i) {
+        Frame frame = machine->frames[base + i];
+        frame.args_begin -= args_begin;
+        frame.arg_pos -= args_begin;
+        if (frame.args_end != UN_FRAME_REDUCING) frame.args_end -= args_begin;
+        suspension->frames[i] = frame;
+    }
+    memcpy(suspension->args, machine->args.data + args_begin,
+           arg_count * sizeof(Ob));
+    suspension->frame_count = frame_count;
+    suspension->arg_count = arg_count;
+    machine->frame_count = base;
+    machine->args.size = args_begin;
+}
+
+// Pushes the frames of a suspension onto a machine.
+static void Machine_resume(Machine *machine, const Suspension *suspension) {
+    const uint32_t args_begin = machine->args.size;
+    for (uint32_t i = 0; i != suspension->arg_count; ++i) {
+        ObStack_push(&machine->args, suspension->args[i]);
+    }
+    for (uint32_t i = 0; i != suspension->frame_count; ++i) {
+        Frame *frame = Machine_push(machine);
+        *frame = suspension->frames[i];
+        frame->args_begin += args_begin;
+        frame->arg_pos += args_begin;
+        if (frame->args_end != UN_FRAME_REDUCING) {
+            frame->args_end += args_begin;
+        }
+    }
 }
 
-void un_test(unsigned int seed) { Carrier_test(seed); }
+// ---------------------------------------------------------------------------
+// Structure
+// We need the following structure:
+// - app_LRv : Pair Ob -partial-> Ob
+// - app_Lrv : Ob -> List (Pair Ob)
+// - app_Rlv : Ob -> List (Pair Ob)
+// - app_Vlr : Ob -> List (Pair Ob)
+// - abs_LRv : Pair Ob -partial-> Ob
+// - abs_Lrv : Ob -> List (Pair Ob)
+// - abs_Vlr : Ob -> List (Pair Ob)
+// - reduced : Ob -partial-> Ob
+// - pending : ReprioritizableQueue Ob
+
+typedef struct {
+    Carrier carrier;
+
+    Hash hash;  // A shared associative array.
+
+    Hash app_LRv;  // Hash-consed apps, with values in slot.val.
+    InverseHash app_Lrv;
+    InverseHash app_Rlv;
+    InverseHash app_Vlr;
+
+    Hash abs_LRv;  // Abstractions by variable and body, as in abstract().
+    InverseHash abs_Lrv;
+    InverseHash abs_Vlr;
+
+    Hash ints;  // Native ints by value, with obs in slot.val.
+
+    ObQueue pending;  // Apps awaiting simplification, by reference count.
+
+    UnionFind reps;        // Classes of merged obs.
+    ObStack merges;        // Deps awaiting rewriting.
+    ObStack merge_batch;   // Scratch space for merging.
+    ObStack merge_keys;    // Scratch space for merging.
+    AppStack merge_apps;   // Scratch space for merging.
+    AppStack merge_abs;    // Scratch space for merging.
+
+    Machine machine;          // Used when not reducing in parallel.
+    Suspension *suspensions;  // Suspended computations, for GC.
+    struct Workers *workers;  // Set iff reducing in parallel.
+
+    Ob **roots;  // Caller-owned handles that keep obs alive across GC.
+    size_t root_count;
+    size_t root_capacity;
+
+    Mapping mapping;  // The snapshot this was opened from, if any.
+} Structure;
+
+// Records the equation \var.body = val, which must be new.
+static void Structure_insert_abs(Structure *structure, Ob var, Ob body,
+                                 Ob val) {
+    Hash_Node node = {.key = {.ob_pair = {var, body}}};
+    node.slot.val = val;
+    Hash_insert(&structure->abs_LRv, &node);
+    InverseHash_insert(&structure->abs_Lrv, var, body, val);
+    InverseHash_insert(&structure->abs_Vlr, val, var, body);
+    Carrier *carrier = &structure->carrier;
+    AbsList_push(&carrier->nodes[body].abs, &carrier->abs_arena, var, val);
+}
+
+void Structure_init(Structure *structure, size_t capacity) {
+    bzero(structure, sizeof(Structure));
+    if (capacity < UN_CONSTANTS_END) capacity = UN_CONSTANTS_END;
+    const size_t hash_size = round_up_to_power_of_2(2UL * capacity);
+    Carrier_init(&structure->carrier, capacity);
+    Hash_init(&structure->hash, hash_size);
+    Hash_init(&structure->app_LRv, hash_size);
+    InverseHash_init(&structure->app_Lrv, capacity);
+    InverseHash_init(&structure->app_Rlv, capacity);
+    InverseHash_init(&structure->app_Vlr, capacity);
+    Hash_init(&structure->abs_LRv, UN_INIT_CAPACITY);
+    InverseHash_init(&structure->abs_Lrv, UN_INIT_CAPACITY);
+    InverseHash_init(&structure->abs_Vlr, UN_INIT_CAPACITY);
+    Hash_init(&structure->ints, UN_INIT_CAPACITY);
+    ObQueue_init(&structure->pending, capacity);
+    ObStack_init(&structure->merges);
+    ObStack_init(&structure->merge_batch);
+    ObStack_init(&structure->merge_keys);
+    Machine_init(&structure->machine);
+
+    // Init constants.
+    Ob ob;
+    ob = Carrier_alloc(&structure->carrier);
+    UN_CHECK_EQ(ob, UN_TOP, "u");
+    ob = Carrier_alloc(&structure->carrier);
+    UN_CHECK_EQ(ob, UN_BOT, "u");
+    ob = Carrier_alloc(&structure->carrier);
+    UN_CHECK_EQ(ob, UN_I, "u");
+    ob = Carrier_alloc(&structure->carrier);
+    UN_CHECK_EQ(ob, UN_K, "u");
+    ob = Carrier_alloc(&structure->carrier);
+    UN_CHECK_EQ(ob, UN_B, "u");
+    ob = Carrier_alloc(&structure->carrier);
+    UN_CHECK_EQ(ob, UN_C, "u");
+    ob = Carrier_alloc(&structure->carrier);
+    UN_CHECK_EQ(ob, UN_S, "u");
+    ob = Carrier_alloc(&structure->carrier);
+    UN_CHECK_EQ(ob, UN_J, "u");
+
+    // Init variables.
+    for (Ob var = UN_VARS_BEGIN; var != UN_VARS_END; ++var) {
+        ob = Carrier_alloc(&structure->carrier);
+        UN_CHECK_EQ(ob, var, "u");
+        structure->carrier.nodes[ob].vars = 1U << (var - UN_VARS_BEGIN);
+
+        // Set \x.x = I.
+        Structure_insert_abs(structure, var, var, UN_I);
+    }
+
+    // Init natives.
+    for (Ob native = UN_VARS_END; native != UN_CONSTANTS_END; ++native) {
+        ob = Carrier_alloc(&structure->carrier);
+        UN_CHECK_EQ(ob, native, "u");
+    }
+}
+
+void Structure_clear(Structure *structure) {
+    Carrier_clear(&structure->carrier);
+    Hash_clear(&structure->hash);
+    Hash_clear(&structure->app_LRv);
+    InverseHash_clear(&structure->app_Lrv);
+    InverseHash_clear(&structure->app_Rlv);
+    InverseHash_clear(&structure->app_Vlr);
+    Hash_clear(&structure->abs_LRv);
+    InverseHash_clear(&structure->abs_Lrv);
+    InverseHash_clear(&structure->abs_Vlr);
+    Hash_clear(&structure->ints);
+    ObQueue_clear(&structure->pending);
+    UnionFind_clear(&structure->reps);
+    ObStack_delete(&structure->merges);
+    ObStack_delete(&structure->merge_batch);
+    ObStack_delete(&structure->merge_keys);
+    AppStack_clear(&structure->merge_apps);
+    AppStack_clear(&structure->merge_abs);
+    Machine_delete(&structure->machine);
+    free(structure->roots);
+}
+
+void Structure_validate(const Structure *structure) {
+    Hash_validate(&structure->hash);
+    Hash_validate(&structure->app_LRv);
+    InverseHash_validate(&structure->app_Lrv);
+    InverseHash_validate(&structure->app_Rlv);
+    InverseHash_validate(&structure->app_Vlr);
+    Hash_validate(&structure->abs_LRv);
+    InverseHash_validate(&structure->abs_Lrv);
+    InverseHash_validate(&structure->abs_Vlr);
+    Hash_validate(&structure->ints);
+    ObQueue_validate(&structure->pending);
+    UN_CHECK_EQ(structure->app_Lrv.count, structure->app_LRv.count, "zu");
+    UN_CHECK_EQ(structure->app_Rlv.count, structure->app_LRv.count, "zu");
+    UN_CHECK_EQ(structure->app_Vlr.count, structure->app_LRv.count, "zu");
+    UN_CHECK_EQ(structure->abs_Lrv.count, structure->abs_LRv.count, "zu");
+    UN_CHECK_EQ(structure->abs_Vlr.count, structure->abs_LRv.count, "zu");
+
+    // The abs inverses are updated entry by entry, so check each entry.
+    for (Ob key = 1U; key < structure->abs_Lrv.key_capacity; ++key) {
+        InverseHash_Iter iter;
+        const ObPair *pair;
+        InverseHash_Iter_init(&iter, &structure->abs_Lrv, key);
+        while ((pair = InverseHash_Iter_next(&iter))) {
+            const Word abs_key = {.ob_pair = {key, pair->lhs}};
+            const Hash_Node *node = Hash_find(&structure->abs_LRv, abs_key);
+            UN_CHECK(node, "abs_Lrv entry missing from abs_LRv");
+            UN_CHECK_EQ(node->slot.val, pair->rhs, "u");
+        }
+    }
+    for (Ob key = 1U; key < structure->abs_Vlr.key_capacity; ++key) {
+        InverseHash_Iter iter;
+        const ObPair *pair;
+        InverseHash_Iter_init(&iter, &structure->abs_Vlr, key);
+        while ((pair = InverseHash_Iter_next(&iter))) {
+            const Word abs_key = {.ob_pair = {pair->lhs, pair->rhs}};
+            const Hash_Node *node = Hash_find(&structure->abs_LRv, abs_key);
+            UN_CHECK(node, "abs_Vlr entry missing from abs_LRv");
+            UN_CHECK_EQ(node->slot.val, key, "u");
+        }
+    }
+}
+
+// Completes incremental growth of every Hash, before passes over their arrays.
+static void Structure_finish_grows(Structure *structure) {
+    Hash_finish_grow(&structure->hash);
+    Hash_finish_grow(&structure->app_LRv);
+    Hash_finish_grow(&structure->abs_LRv);
+    Hash_finish_grow(&structure->ints);
+}
+
+// Records the equation APP lhs rhs = val, which must be new.
+static void Structure_insert_app(Structure *structure, Ob lhs, Ob rhs,
+                                 Ob val) {
+    Hash_Node node = {.key = {.ob_pair = {lhs, rhs}}};
+    node.slot.val = val;
+    Hash_insert(&structure->app_LRv, &node);
+    InverseHash_insert(&structure->app_Lrv, lhs, rhs, val);
+    InverseHash_insert(&structure->app_Rlv, rhs, lhs, val);
+    InverseHash_insert(&structure->app_Vlr, val, lhs, rhs);
+}
+
+// Keys must be nonzero, so the high half of each int key is set.
+static inline Word int_key(int32_t value) {
+    const Word key = {.uint32s = {(uint32_t)value, 1U}};
+    return key;
+}
+
+// Allocates a native int, which must be new.
+static Ob Structure_insert_int(Structure *structure, int32_t value) {
+    const Ob ob = Carrier_alloc(&structure->carrier);
+    structure->carrier.nodes[ob].obs[1] = (uint32_t)value;
+    Hash_Node node = {.key = int_key(value)};
+    node.slot.val = ob;
+    Hash_insert(&structure->ints, &node);
+    return ob;
+}
+
+// ---------------------------------------------------------------------------
+// Merging
+//
+// Merging follows Todd-Coxeter coset enumeration: asserting dep = rep
+// unions their classes and queues dep. Queued deps are then processed in
+// batches, each batch rewriting all app and abstraction entries that mention
+// any of its deps in a few bulk passes, found through the inverse indices and
+// each body's AbsList. Rewritten entries that collide with existing entries
+// imply further equations (congruence closure), which are queued for the
+// next batch. Thus merging costs time proportional to the entries of merged
+// obs, not to the size of the tables.
+//
+// Memo entries are not indexed, so they are left stale: an entry keyed by a
+// dep still holds, but misses lookups by reps until collection rewrites the
+// memo. Values are canonicalized lazily, as lookups find them.
+
+static int App_compare(const void *lhs_ptr, const void *rhs_ptr) {
+    const App *lhs = lhs_ptr;
+    const App *rhs = rhs_ptr;
+    if (lhs->lhs != rhs->lhs) return lhs->lhs < rhs->lhs ? -1 : 1;
+    if (lhs->rhs != rhs->rhs) return lhs->rhs < rhs->rhs ? -1 : 1;
+    if (lhs->val != rhs->val) return lhs->val < rhs->val ? -1 : 1;
+    return 0;
+}
+
+static int Ob_compare(const void *lhs_ptr, const void *rhs_ptr) {
+    const Ob lhs = *(const Ob *)lhs_ptr;
+    const Ob rhs = *(const Ob *)rhs_ptr;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+// Sorts and deduplicates an ObStack.
+static void ObStack_sort_unique(ObStack *stack) {
+    if (stack->size < 2U) return;
+    qsort(stack->data, stack->size, sizeof(Ob), Ob_compare);
+    uint32_t size = 1U;
+    for (uint32_t i = 1U; i != stack->size; ++i) {
+        if (stack->data[i] != stack->data[size - 1U]) {
+            stack->data[size++] = stack->data[i];
+        }
+    }
+    stack->size = size;
+}
+
+// Sorts and deduplicates an AppStack.
+static void AppStack_sort_unique(AppStack *stack) {
+    if (stack->size < 2UL) return;
+    qsort(stack->data, stack->size, sizeof(App), App_compare);
+    size_t size = 1UL;
+    for (size_t i = 1UL; i != stack->size; ++i) {
+        if (App_compare(stack->data + i, stack->data + size - 1UL)) {
+            stack->data[size++] = stack->data[i];
+        }
+    }
+    stack->size = size;
+}
+
+// Asserts dep = rep, keeping rep's class representative. Returns that rep.
+static Ob Structure_merge(Structure *structure, Ob dep, Ob rep) {
+    dep = UnionFind_find(&structure->reps, dep);
+    rep = UnionFind_find(&structure->reps, rep);
+    if (dep != rep) {
+        UnionFind_merge(&structure->reps, dep, rep);
+        ObStack_push(&structure->merges, dep);
+    }
+    return rep;
+}
+
+// Asserts lhs = rhs, keeping the older ob as representative, unless the
+// newer is a native int, which must stay its own rep to be recognized.
+static Ob Structure_ensure_equal(Structure *structure, Ob lhs, Ob rhs) {
+    lhs = UnionFind_find(&structure->reps, lhs);
+    rhs = UnionFind_find(&structure->reps, rhs);
+    const Carrier *carrier = &structure->carrier;
+    const bool keep_lhs = (lhs < rhs) ? !Carrier_is_int(carrier, rhs)
+                                      : Carrier_is_int(carrier, lhs);
+    return keep_lhs ? Structure_merge(structure, rhs, lhs)
+                    : Structure_merge(structure, lhs, rhs);
+}
+
+static bool Structure_is_unmerged(const ObPair *pair, Ob key, void *data) {
+    const UnionFind *reps = data;
+    return UnionFind_is_rep(reps, key) && UnionFind_is_rep(reps, pair->lhs) &&
+           UnionFind_is_rep(reps, pair->rhs);
+}
+
+// Records APP lhs rhs = val modulo merged obs, merging on collision.
+static void Structure_ensure_app(Structure *structure, Ob lhs, Ob rhs,
+                                 Ob val) {
+    UnionFind *reps = &structure->reps;
+    lhs = UnionFind_find(reps, lhs);
+    rhs = UnionFind_find(reps, rhs);
+    val = UnionFind_find(reps, val);
+    Word key = {.ob_pair = {lhs, rhs}};
+    const Hash_Node *node = Hash_find(&structure->app_LRv, key);
+    if (node) {
+        Structure_ensure_equal(structure, node->slot.val, val);
+    } else {
+        Structure_insert_app(structure, lhs, rhs, val);
+    }
+}
+
+// Filters merged entries from an index, whose keys are the lhs, rhs or val
+// of entries (as field is 0, 1 or 2). Each affected key is filtered once.
+static void Structure_filter_index(Structure *structure, InverseHash *index,
+                                   const AppStack *entries, int field) {
+    ObStack *keys = &structure->merge_keys;
+    keys->size = 0;
+    for (size_t i = 0; i != entries->size; ++i) {
+        const App *entry = entries->data + i;
+        ObStack_push(keys, field == 0   ? entry->lhs
+                           : field == 1 ? entry->rhs
+                                        : entry->val);
+    }
+    ObStack_sort_unique(keys);
+    for (uint32_t i = 0; i != keys->size; ++i) {
+        InverseHash_filter(index, keys->data[i], Structure_is_unmerged,
+                           &structure->reps);
+    }
+}
+
+// Collects into merge_abs the abstractions \var.body = val mentioning dep,
+// as var, body or val.
+static void Structure_collect_abs(Structure *structure, Ob dep) {
+    AppStack *abs = &structure->merge_abs;
+    InverseHash_Iter iter;
+    const ObPair *pair;
+    InverseHash_Iter_init(&iter, &structure->abs_Lrv, dep);
+    while ((pair = InverseHash_Iter_next(&iter))) {
+        AppStack_push(abs, dep, pair->lhs, pair->rhs);
+    }
+    InverseHash_Iter_init(&iter, &structure->abs_Vlr, dep);
+    while ((pair = InverseHash_Iter_next(&iter))) {
+        AppStack_push(abs, pair->lhs, pair->rhs, dep);
+    }
+
+    // Bodies are indexed by their AbsLists. A list may also hold stale nodes
+    // whose entries moved to a newer rep, which the rep's list also holds.
+    const AbsList *list = &structure->carrier.nodes[dep].abs;
+    const AbsList_Node *nodes = AbsList_const_nodes(list);
+    const size_t size = AbsList_size(list);
+    for (size_t i = 0; i != size; ++i) {
+        const Word key = {.ob_pair = {nodes[i].key, dep}};
+        const Hash_Node *node = Hash_find(&structure->abs_LRv, key);
+        if (node) AppStack_push(abs, nodes[i].key, dep, node->slot.val);
+    }
+}
+
+// Rewrites the abstractions collected in merge_abs, as for apps.
+static void Structure_rewrite_abs(Structure *structure) {
+    UnionFind *reps = &structure->reps;
+    AppStack *abs = &structure->merge_abs;
+    if (!abs->size) return;
+    AppStack_sort_unique(abs);
+    for (size_t i = 0; i != abs->size; ++i) {
+        Word key = {.ob_pair = {abs->data[i].lhs, abs->data[i].rhs}};
+        Hash_Node *node = Hash_find(&structure->abs_LRv, key);
+        UN_DCHECK_TRUE(node);
+        Hash_erase(&structure->abs_LRv, node);
+    }
+    Structure_filter_index(structure, &structure->abs_Lrv, abs, 0);
+    Structure_filter_index(structure, &structure->abs_Vlr, abs, 2);
+
+    // Reinsert canonical abstractions, possibly queueing more merges.
+    Carrier *carrier = &structure->carrier;
+    for (size_t i = 0; i != abs->size; ++i) {
+        const Ob var = UnionFind_find(reps, abs->data[i].lhs);
+        const Ob body = UnionFind_find(reps, abs->data[i].rhs);
+        const Ob val = UnionFind_find(reps, abs->data[i].val);
+        Word key = {.ob_pair = {var, body}};
+        const Hash_Node *node = Hash_find(&structure->abs_LRv, key);
+        if (node) {
+            Structure_ensure_equal(structure, node->slot.val, val);
+            continue;
+        }
+        Hash_Node node_to_insert = {.key = key};
+        node_to_insert.slot.val = val;
+        Hash_insert(&structure->abs_LRv, &node_to_insert);
+        InverseHash_insert(&structure->abs_Lrv, var, body, val);
+        InverseHash_insert(&structure->abs_Vlr, val, var, body);
+        AbsList *list = &carrier->nodes[body].abs;
+        if (!AbsList_set(list, var, val)) {
+            AbsList_push(list, &carrier->abs_arena, var, val);
+        }
+    }
+}
+
+// Rewrites all app and abstraction entries mentioning a batch of merged deps.
+static void Structure_rewrite_apps(Structure *structure, const ObStack *deps) {
+    UnionFind *reps = &structure->reps;
+    AppStack *apps = &structure->merge_apps;
+    apps->size = 0;
+    structure->merge_abs.size = 0;
+    for (uint32_t i = 0; i != deps->size; ++i) {
+        const Ob dep = deps->data[i];
+        InverseHash_Iter iter;
+        const ObPair *pair;
+        InverseHash_Iter_init(&iter, &structure->app_Lrv, dep);
+        while ((pair = InverseHash_Iter_next(&iter))) {
+            AppStack_push(apps, dep, pair->lhs, pair->rhs);
+        }
+        InverseHash_Iter_init(&iter, &structure->app_Rlv, dep);
+        while ((pair = InverseHash_Iter_next(&iter))) {
+            AppStack_push(apps, pair->lhs, dep, pair->rhs);
+        }
+        InverseHash_Iter_init(&iter, &structure->app_Vlr, dep);
+        while ((pair = InverseHash_Iter_next(&iter))) {
+            AppStack_push(apps, pair->lhs, pair->rhs, dep);
+        }
+        Structure_collect_abs(structure, dep);
+
+        // Deps are no longer pending; their reps inherit their priority.
+        const uint32_t priority = ObQueue_priority(&structure->pending, dep);
+        if (priority) {
+            ObQueue_remove(&structure->pending, dep);
+            const Ob rep = UnionFind_find(reps, dep);
+            const uint32_t rep_priority =
+                ObQueue_priority(&structure->pending, rep);
+            if (rep_priority) {
+                ObQueue_push(&structure->pending, rep, rep_priority + priority);
+            }
+        }
+
+        // Move abstractions of dep to rep. Their entries are rewritten below,
+        // which fixes the vals of moved nodes.
+        Carrier *carrier = &structure->carrier;
+        AbsList *abs = &carrier->nodes[dep].abs;
+        const size_t abs_size = AbsList_size(abs);
+        if (abs_size) {
+            AbsList *rep_abs = &carrier->nodes[UnionFind_find(reps, dep)].abs;
+            const AbsList_Node *nodes = AbsList_const_nodes(abs);
+            for (size_t j = 0; j != abs_size; ++j) {
+                if (!AbsList_find(rep_abs, nodes[j].key)) {
+                    AbsList_push(rep_abs, &carrier->abs_arena, nodes[j].key,
+                                 nodes[j].val);
+                }
+            }
+            AbsList_clear(abs, &carrier->abs_arena);
+        }
+    }
+    Structure_rewrite_abs(structure);
+    if (!apps->size) return;
+
+    // Apps mentioning two deps were collected twice.
+    AppStack_sort_unique(apps);
+
+    // Remove stale entries in bulk, filtering each affected key once.
+    for (size_t i = 0; i != apps->size; ++i) {
+        Word key = {.ob_pair = {apps->data[i].lhs, apps->data[i].rhs}};
+        Hash_Node *node = Hash_find(&structure->app_LRv, key);
+        UN_DCHECK_TRUE(node);
+        Hash_erase(&structure->app_LRv, node);
+    }
+    Structure_filter_index(structure, &structure->app_Lrv, apps, 0);
+    Structure_filter_index(structure, &structure->app_Rlv, apps, 1);
+    Structure_filter_index(structure, &structure->app_Vlr, apps, 2);
+
+    // Reinsert canonical apps, possibly queueing more merges.
+    for (size_t i = 0; i != apps->size; ++i) {
+        const App *app = apps->data + i;
+        Structure_ensure_app(structure, app->lhs, app->rhs, app->val);
+    }
+}
+
+// Rewrites all memo entries mentioning merged obs, in one pass over the memo.
+static void Structure_rewrite_memo(Structure *structure) {
+    UnionFind *reps = &structure->reps;
+    AppStack *apps = &structure->merge_apps;
+    Hash *memo = &structure->hash;
+    apps->size = 0;
+    Hash_finish_grow(memo);
+    for (Hash_Node *node = memo->nodes, *end = node + memo->size; node != end;
+         ++node) {
+        if (!node->key.uint64s[0]) continue;
+        const Ob old_lhs = node->key.ob_pair.lhs;
+        const Ob old_rhs = node->key.ob_pair.rhs;
+        const Ob lhs = UnionFind_find(reps, old_lhs);
+        const Ob rhs = UnionFind_find(reps, old_rhs);
+        const Ob val = UnionFind_find(reps, node->slot.val);
+        if (lhs != old_lhs || rhs != old_rhs) {
+            AppStack_push(apps, lhs, rhs, val);
+            Hash_erase(memo, node);
+        } else if (val != node->slot.val) {
+            UN_ATOMIC_STORE(&node->slot.val, val, RELEASE);
+        }
+    }
+    for (size_t i = 0; i != apps->size; ++i) {
+        const App *app = apps->data + i;
+        Word key = {.ob_pair = {app->lhs, app->rhs}};
+        const Hash_Node *node = Hash_find(memo, key);
+        if (node) {
+            Structure_ensure_equal(structure, node->slot.val, app->val);
+        } else {
+            Hash_Node node_to_insert = {.key = key};
+            node_to_insert.slot.val = app->val;
+            Hash_insert(memo, &node_to_insert);
+        }
+    }
+}
+
+// Processes all queued merges and their consequences.
+static void Structure_process_merges(Structure *structure) {
+    while (structure->merges.size) {
+        ObStack batch = structure->merges;
+        structure->merges = structure->merge_batch;
+        structure->merges.size = 0;
+        Structure_rewrite_apps(structure, &batch);
+        structure->merge_batch = batch;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Garbage collection
+//
+// Obs are live if reachable from a root, a constant or a suspended
+// computation, following app structure and union-find parents. Memo and app
+// entries mentioning a dead ob are dropped, as are dead native ints, and
+// AbsList entries whose values are dead are dropped. Memo keys left stale by
+// merges are rewritten to reps first, so that their entries hit again.
+// Collection either frees dead obs in place, or compacts live obs into a
+// dense prefix, numbered in order of spines reachable from roots, so that
+// unwinding a spine walks adjacent nodes. Every table is rebuilt through
+// a map from old to new obs, where dead obs map to 0.
+
+static void Structure_add_root(Structure *structure, Ob *root) {
+    if (structure->root_count == structure->root_capacity) {
+        structure->root_capacity =
+            structure->root_capacity ? 2UL * structure->root_capacity : 16UL;
+        structure->roots = realloc_or_die(
+            structure->roots, structure->root_capacity * sizeof(Ob *));
+    }
+    structure->roots[structure->root_count++] = root;
+}
+
+static void Structure_remove_root(Structure *structure, Ob *root) {
+    for (size_t i = structure->root_count; i--;) {
+        if (structure->roots[i] == root) {
+            structure->roots[i] = structure->roots[--structure->root_count];
+            return;
+        }
+    }
+    UN_CHECK(false, "unregistered root");
+}
+
+static inline bool Carrier_is_app(const Carrier *carrier, Ob ob) {
+    return carrier->nodes[ob].obs[0] && carrier->nodes[ob].obs[1];
+}
+
+// Returns an array of flags, indexed by ob.
+static uint8_t *Structure_mark(Structure *structure) {
+    const Carrier *carrier = &structure->carrier;
+    uint8_t *live = calloc(carrier->free_range, sizeof(uint8_t));
+    UN_CHECK(live, "out of memory, size = %u", carrier->free_range);
+    ObStack stack;
+    ObStack_init(&stack);
+    for (Ob ob = 1U; ob != UN_CONSTANTS_END; ++ob) live[ob] = 1U;
+    for (size_t i = 0; i != structure->root_count; ++i) {
+        const Ob root = *structure->roots[i];
+        UN_CHECK(0U < root && root < carrier->free_range, "invalid root: %u",
+                 root);
+        ObStack_push(&stack, root);
+    }
+    for (const Suspension *suspension = structure->suspensions; suspension;
+         suspension = suspension->next) {
+        for (uint32_t i = 0; i != suspension->frame_count; ++i) {
+            const Frame *frame = suspension->frames + i;
+            ObStack_push(&stack, frame->lhs);
+            ObStack_push(&stack, frame->rhs);
+            ObStack_push(&stack, frame->head);
+        }
+        for (uint32_t i = 0; i != suspension->arg_count; ++i) {
+            ObStack_push(&stack, suspension->args[i]);
+        }
+    }
+    for (Ob ob; (ob = ObStack_try_pop(&stack));) {
+        if (live[ob]) continue;
+        live[ob] = 1U;
+        if (Carrier_is_app(carrier, ob)) {
+            ObStack_push(&stack, carrier->nodes[ob].obs[0]);
+            ObStack_push(&stack, carrier->nodes[ob].obs[1]);
+        }
+        if (!UnionFind_is_rep(&structure->reps, ob)) {
+            ObStack_push(&stack, structure->reps.parents[ob]);
+        }
+    }
+    ObStack_delete(&stack);
+    return live;
+}
+
+// Numbers live obs densely, visiting each spine from a root before the
+// args hanging off it. Returns the new free_range.
+static Ob Structure_number(const Structure *structure, const uint8_t *live,
+                           Ob *map) {
+    const Carrier *carrier = &structure->carrier;
+    Ob next = UN_CONSTANTS_END;
+    ObStack queue;  // Used as a FIFO, with a read position.
+    ObStack_init(&queue);
+    for (size_t i = 0; i != structure->root_count; ++i) {
+        ObStack_push(&queue, *structure->roots[i]);
+    }
+    for (uint32_t pos = 0; pos != queue.size; ++pos) {
+        Ob ob = queue.data[pos];
+        for (; !map[ob]; ob = carrier->nodes[ob].obs[0]) {
+            map[ob] = next++;
+            if (!Carrier_is_app(carrier, ob)) break;
+            ObStack_push(&queue, carrier->nodes[ob].obs[1]);
+        }
+    }
+    ObStack_delete(&queue);
+    for (Ob ob = UN_CONSTANTS_END; ob < carrier->free_range; ++ob) {
+        if (live[ob] && !map[ob]) map[ob] = next++;
+    }
+    return next;
+}
+
+// Rebuilds a list in a new arena, freeing the old list in its old arena.
+static void AbsList_remap(AbsList *list, AbsArena *old_arena,
+                          AbsArena *new_arena, const Ob *map) {
+    AbsList remapped;
+    bzero(&remapped, sizeof(AbsList));
+    const AbsList_Node *nodes = AbsList_const_nodes(list);
+    const size_t size = AbsList_size(list);
+    for (size_t i = 0; i != size; ++i) {
+        const Ob key = map[nodes[i].key];
+        const Ob val = map[nodes[i].val];
+        if (key && val) AbsList_push(&remapped, new_arena, key, val);
+    }
+    AbsList_clear(list, old_arena);
+    *list = remapped;
+}
+
+// Replaces the nodes of a Hash by those of a rebuilt copy of the same size.
+static void Hash_replace(Hash *hash, Hash *remapped) {
+    Hash_Node *old_nodes = hash->nodes;
+    UN_ATOMIC_STORE(&hash->nodes, remapped->nodes, SEQ_CST);
+    hash->count = remapped->count;
+    retire_pages(hash->epoch, hash->mapping, old_nodes,
+                 sizeof(Hash_Node) * hash->size);
+}
+
+// Rebuilds a Hash whose keys and values are obs, at the same size so that
+// concurrent readers remain safe.
+static void Hash_remap(Hash *hash, const Ob *map) {
+    Hash_finish_grow(hash);
+    Hash remapped;
+    Hash_init(&remapped, hash->size);
+    for (size_t i = 0; i != hash->size; ++i) {
+        const Hash_Node *node = hash->nodes + i;
+        if (!node->key.uint64s[0]) continue;
+        Hash_Node node_to_insert = *node;
+        bool alive = true;
+        for (int j = 0; j != 3; ++j) {
+            node_to_insert.uint32s[j] = map[node->uint32s[j]];
+            alive = alive && node_to_insert.uint32s[j];
+        }
+        if (alive) Hash_insert_nogrow(&remapped, &node_to_insert);
+    }
+    Hash_replace(hash, &remapped);
+}
+
+// Like Hash_remap, but for a Hash whose keys are not obs.
+static void Hash_remap_vals(Hash *hash, const Ob *map) {
+    Hash_finish_grow(hash);
+    Hash remapped;
+    Hash_init(&remapped, hash->size);
+    for (size_t i = 0; i != hash->size; ++i) {
+        const Hash_Node *node = hash->nodes + i;
+        if (!node->key.uint64s[0]) continue;
+        Hash_Node node_to_insert = *node;
+        node_to_insert.slot.val = map[node->slot.val];
+        if (node_to_insert.slot.val) {
+            Hash_insert_nogrow(&remapped, &node_to_insert);
+        }
+    }
+    Hash_replace(hash, &remapped);
+}
+
+// Collects garbage, returning the number of obs freed.
+static size_t Structure_gc(Structure *structure, bool compact) {
+    do {
+        Structure_process_merges(structure);
+        Structure_rewrite_memo(structure);
+    } while (structure->merges.size);
+    Structure_finish_grows(structure);
+    Carrier *carrier = &structure->carrier;
+    const Ob free_range = carrier->free_range;
+    uint8_t *live = Structure_mark(structure);
+
+    // Build the map from old to new obs.
+    Ob *map = calloc(free_range, sizeof(Ob));
+    UN_CHECK(map, "out of memory, size = %u", free_range);
+    size_t freed = 0;
+    Ob new_free_range = free_range;
+    if (compact) {
+        for (Ob ob = 1U; ob != UN_CONSTANTS_END; ++ob) map[ob] = ob;
+        new_free_range = Structure_number(structure, live, map);
+    }
+    for (Ob ob = UN_CONSTANTS_END; ob < free_range; ++ob) {
+        if (!compact && live[ob]) map[ob] = ob;
+        freed += !live[ob] && Carrier_is_app(carrier, ob);
+    }
+    if (!compact) {
+        for (Ob ob = 1U; ob != UN_CONSTANTS_END; ++ob) map[ob] = ob;
+    }
+
+    // Ints are not apps, so dead ints are found through their table.
+    const Hash *ints = &structure->ints;
+    for (size_t i = 0; i != ints->size; ++i) {
+        const Hash_Node *node = ints->nodes + i;
+        if (!node->key.uint64s[0] || live[node->slot.val]) continue;
+        ++freed;
+        if (!compact) Carrier_free(carrier, node->slot.val);
+    }
+
+    // Rebuild the Carrier.
+    if (compact) {
+        // Lists move into a fresh arena, so the old one is released in bulk.
+        AbsArena abs_arena;
+        bzero(&abs_arena, sizeof(AbsArena));
+        size_t reserved;
+        Carrier_Node *nodes = Carrier_new_nodes(carrier->capacity, &reserved);
+        for (Ob ob = 1U; ob < free_range; ++ob) {
+            Carrier_Node *node = carrier->nodes + ob;
+            if (!map[ob]) {
+                AbsList_clear(&node->abs, &carrier->abs_arena);
+                continue;
+            }
+            Carrier_Node *moved = nodes + map[ob];
+            if (Carrier_is_app(carrier, ob)) {
+                moved->obs[0] = map[node->obs[0]];
+                moved->obs[1] = map[node->obs[1]];
+            } else {
+                moved->obs[1] = node->obs[1];  // The value of an int.
+            }
+            moved->vars = node->vars;
+            moved->abs = node->abs;
+            AbsList_remap(&moved->abs, &carrier->abs_arena, &abs_arena, map);
+        }
+        AbsArena_clear(&carrier->abs_arena);
+        carrier->abs_arena = abs_arena;
+        Carrier_Node *old_nodes = carrier->nodes;
+        const size_t old_reserved = carrier->reserved;
+        UN_ATOMIC_STORE(&carrier->nodes, nodes, SEQ_CST);
+        carrier->reserved = reserved;
+        retire_pages(carrier->epoch, carrier->mapping, old_nodes,
+                     old_reserved);
+        carrier->free_range = new_free_range;
+        carrier->free_list = 0U;
+        carrier->free_count = 0U;
+    } else {
+        AbsArena *abs_arena = &carrier->abs_arena;
+        for (Ob ob = free_range; ob-- > 1U;) {
+            if (!live[ob] && Carrier_is_app(carrier, ob)) {
+                Carrier_free(carrier, ob);
+            } else if (live[ob]) {
+                AbsList_remap(&carrier->nodes[ob].abs, abs_arena, abs_arena,
+                              map);
+            }
+        }
+    }
+
+    // Rebuild tables.
+    Hash_remap(&structure->hash, map);
+    Hash_remap(&structure->app_LRv, map);
+    Hash_remap(&structure->abs_LRv, map);
+    Hash_remap_vals(&structure->ints, map);
+    InverseHash *inverses[5] = {&structure->app_Lrv, &structure->app_Rlv,
+                                &structure->app_Vlr, &structure->abs_Lrv,
+                                &structure->abs_Vlr};
+    for (int i = 0; i != 5; ++i) {
+        InverseHash_clear(inverses[i]);
+        InverseHash_init(inverses[i], carrier->capacity);
+    }
+    const Hash *app_LRv = &structure->app_LRv;
+    for (size_t i = 0; i != app_LRv->size; ++i) {
+        const Hash_Node *node = app_LRv->nodes + i;
+        if (!node->key.uint64s[0]) continue;
+        const Ob lhs = node->uint32s[0];
+        const Ob rhs = node->uint32s[1];
+        const Ob val = node->uint32s[2];
+        InverseHash_insert(&structure->app_Lrv, lhs, rhs, val);
+        InverseHash_insert(&structure->app_Rlv, rhs, lhs, val);
+        InverseHash_insert(&structure->app_Vlr, val, lhs, rhs);
+    }
+    const Hash *abs_LRv = &structure->abs_LRv;
+    for (size_t i = 0; i != abs_LRv->size; ++i) {
+        const Hash_Node *node = abs_LRv->nodes + i;
+        if (!node->key.uint64s[0]) continue;
+        const Ob var = node->uint32s[0];
+        const Ob body = node->uint32s[1];
+        const Ob val = node->uint32s[2];
+        InverseHash_insert(&structure->abs_Lrv, var, body, val);
+        InverseHash_insert(&structure->abs_Vlr, val, var, body);
+    }
+    {
+        ObQueue pending;
+        ObQueue_init(&pending, carrier->capacity);
+        for (uint32_t i = 0; i != structure->pending.size; ++i) {
+            const ObQueue_Entry entry = structure->pending.heap[i];
+            const Ob ob = map[entry.ob];
+            if (ob) ObQueue_push(&pending, ob, entry.priority);
+        }
+        ObQueue_clear(&structure->pending);
+        structure->pending = pending;
+    }
+    {
+        UnionFind *reps = &structure->reps;
+        Ob *parents = calloc(reps->capacity ? reps->capacity : 1U, sizeof(Ob));
+        UN_CHECK(parents, "out of memory, size = %u", reps->capacity);
+        for (Ob ob = 1U; ob < reps->capacity && ob < free_range; ++ob) {
+            if (map[ob] && reps->parents[ob]) {
+                UN_DCHECK_TRUE(map[reps->parents[ob]]);
+                parents[map[ob]] = map[reps->parents[ob]];
+            }
+        }
+        free_owned(reps->mapping, reps->parents);
+        reps->parents = parents;
+        if (!reps->capacity) reps->capacity = 1U;
+    }
+    for (size_t i = 0; i != structure->root_count; ++i) {
+        *structure->roots[i] = map[*structure->roots[i]];
+    }
+    for (Suspension *suspension = structure->suspensions; suspension;
+         suspension = suspension->next) {
+        for (uint32_t i = 0; i != suspension->frame_count; ++i) {
+            Frame *frame = suspension->frames + i;
+            frame->lhs = map[frame->lhs];
+            frame->rhs = map[frame->rhs];
+            frame->head = map[frame->head];
+        }
+        for (uint32_t i = 0; i != suspension->arg_count; ++i) {
+            suspension->args[i] = map[suspension->args[i]];
+        }
+    }
+
+    free(map);
+    free(live);
+    return freed;
+}
+
+// ---------------------------------------------------------------------------
+// Workers
+//
+// Independent args are simplified in parallel by a pool of threads, each
+// with a work-stealing deque (Chase & Lev 2005). While the pool is active,
+// the thread driving the engine owns the first deque. Threads read the
+// Structure without locking and serialize all writes through a single lock;
+// merges never run while args are being simplified.
+
+#define UN_WORK_DEQUE_CAPACITY 1024
+#define UN_PARALLEL_CUTOFF 64U  // Args with fewer apps are simplified inline.
+#define UN_WORKER_SPINS 64U     // Failed steals before an idle worker parks.
+
+typedef struct {
+    Ob ob;  // An arg before simplification and its result after.
+    uint32_t pos;
+    uint32_t done;
+    uint32_t sampling;  // Whether to sample ob rather than simplify it.
+    int budget;         // Of a sample, which draws from key.
+    uint64_t key;
+} Task;
+
+typedef struct {
+    int64_t top;  // Advanced by thieves.
+    uint8_t padding[UN_CACHE_LINE_BYTES - sizeof(int64_t)];
+    int64_t bottom;  // Advanced and retreated by the owner.
+    Task *tasks[UN_WORK_DEQUE_CAPACITY];
+} WorkDeque;
+
+// Returns false if the deque is full.
+static bool WorkDeque_push(WorkDeque *deque, Task *task) {
+    const int64_t bottom = UN_ATOMIC_LOAD(&deque->bottom, RELAXED);
+    const int64_t top = UN_ATOMIC_LOAD(&deque->top, ACQUIRE);
+    if (bottom - top >= UN_WORK_DEQUE_CAPACITY) return false;
+    Task **slot = deque->tasks + (bottom & (UN_WORK_DEQUE_CAPACITY - 1));
+    UN_ATOMIC_STORE(slot, task, RELAXED);
+    UN_ATOMIC_STORE(&deque->bottom, bottom + 1, RELEASE);
+    return true;
+}
+
+// Pops the most recently pushed task. Must be called by the owner.
+static Task *WorkDeque_pop(WorkDeque *deque) {
+    const int64_t bottom = UN_ATOMIC_LOAD(&deque->bottom, RELAXED) - 1;
+    UN_ATOMIC_STORE(&deque->bottom, bottom, SEQ_CST);
+    int64_t top = UN_ATOMIC_LOAD(&deque->top, SEQ_CST);
+    if (top > bottom) {
+        UN_ATOMIC_STORE(&deque->bottom, bottom + 1, RELAXED);
+        return NULL;
+    }
+    Task **slot = deque->tasks + (bottom & (UN_WORK_DEQUE_CAPACITY - 1));
+    Task *task = UN_ATOMIC_LOAD(slot, RELAXED);
+    if (top == bottom) {
+        // Race thieves for the last task.
+        if (!UN_ATOMIC_CAS(&deque->top, &top, top + 1)) task = NULL;
+        UN_ATOMIC_STORE(&deque->bottom, bottom + 1, RELAXED);
+    }
+    return task;
+}
+
+// Steals the least recently pushed task. May be called by any thread.
+static Task *WorkDeque_steal(WorkDeque *deque) {
+    int64_t top = UN_ATOMIC_LOAD(&deque->top, SEQ_CST);
+    const int64_t bottom = UN_ATOMIC_LOAD(&deque->bottom, SEQ_CST);
+    if (top >= bottom) return NULL;
+    Task **slot = deque->tasks + (top & (UN_WORK_DEQUE_CAPACITY - 1));
+    Task *task = UN_ATOMIC_LOAD(slot, RELAXED);
+    return UN_ATOMIC_CAS(&deque->top, &top, top + 1) ? task : NULL;
+}
+
+typedef struct {
+    WorkDeque deque;
+    struct Workers *workers;
+    pthread_t thread;
+    uint32_t seed;  // For choosing victims.
+    Machine machine;
+} Worker;
+
+typedef struct Workers {
+    pthread_mutex_t lock;  // Serializes writes to the Structure.
+    Structure *structure;
+    Epoch *epoch;      // Shared with the Structure's Carrier and Hashes.
+    Worker *workers;   // The first is reserved for the driving thread.
+    size_t count;
+    uint32_t active;
+    uint32_t stopping;
+    uint32_t pushes;  // Tasks pushed, for waking parked workers.
+    uint32_t parked;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;  // Signaled on activation.
+    pthread_cond_t work_cond;  // Signaled on pushes to wake parked workers.
+} Workers;
+
+static _Thread_local Worker *t_worker = NULL;
+
+static inline void Structure_lock(Structure *structure) {
+    if (structure->workers) pthread_mutex_lock(&structure->workers->lock);
+}
+
+static inline void Structure_unlock(Structure *structure) {
+    if (structure->workers) pthread_mutex_unlock(&structure->workers->lock);
+}
+
+static Ob simplify(Structure *structure, Ob ob);
+static Ob sample(Structure *structure, Ob ob, uint64_t key, int budget);
+
+// Runs one task, either popped or stolen. Returns false if none was found.
+static bool Worker_work(Worker *worker) {
+    Workers *workers = worker->workers;
+    Task *task = WorkDeque_pop(&worker->deque);
+    if (!task && workers->count > 1UL) {
+        worker->seed ^= worker->seed << 13U;
+        worker->seed ^= worker->seed >> 17U;
+        worker->seed ^= worker->seed << 5U;
+        Worker *victim = workers->workers + worker->seed % workers->count;
+        if (victim != worker) task = WorkDeque_steal(&victim->deque);
+    }
+    if (!task) return false;
+    task->ob = task->sampling ? sample(workers->structure, task->ob,
+                                       task->key, task->budget)
+                              : simplify(workers->structure, task->ob);
+    UN_ATOMIC_STORE(&task->done, 1U, RELEASE);
+    return true;
+}
+
+// Wakes parked workers after a task is pushed.
+static inline void Workers_notify(Workers *workers) {
+    UN_ATOMIC_FETCH_ADD(&workers->pushes, 1U);
+    if (UN_ATOMIC_LOAD(&workers->parked, SEQ_CST)) {
+        pthread_mutex_lock(&workers->idle_lock);
+        pthread_cond_broadcast(&workers->work_cond);
+        pthread_mutex_unlock(&workers->idle_lock);
+    }
+}
+
+// Sleeps until a task is pushed after pushes were counted, or the pool is
+// stopping. A parked worker stays parked across activations, so that
+// engine calls with nothing to share never wake it. Counting parked before
+// reading pushes, as Workers_notify does the reverse, ensures that one of
+// the two sees the other.
+static void Workers_park(Workers *workers, uint32_t pushes) {
+    pthread_mutex_lock(&workers->idle_lock);
+    UN_ATOMIC_FETCH_ADD(&workers->parked, 1U);
+    while (UN_ATOMIC_LOAD(&workers->pushes, SEQ_CST) == pushes &&
+           !workers->stopping) {
+        pthread_cond_wait(&workers->work_cond, &workers->idle_lock);
+    }
+    UN_ATOMIC_FETCH_ADD(&workers->parked, UINT32_MAX);
+    pthread_mutex_unlock(&workers->idle_lock);
+}
+
+static void *Worker_main(void *arg) {
+    Worker *worker = arg;
+    Workers *workers = worker->workers;
+    t_worker = worker;
+    for (;;) {
+        pthread_mutex_lock(&workers->idle_lock);
+        while (!workers->active && !workers->stopping) {
+            pthread_cond_wait(&workers->idle_cond, &workers->idle_lock);
+        }
+        const bool stopping = workers->stopping;
+        pthread_mutex_unlock(&workers->idle_lock);
+        if (stopping) return NULL;
+
+        // Without a slot this thread cannot read, so it sits out until
+        // work is pushed, when it tries again.
+        if (!Epoch_enter(workers->epoch)) {
+            Workers_park(workers, UN_ATOMIC_LOAD(&workers->pushes, SEQ_CST));
+            continue;
+        }
+        Epoch_exit(workers->epoch);
+
+        // Read only while looking for or running a task, so that idle
+        // workers neither hold back reclamation nor sleep inside a read.
+        for (uint32_t idle = 0U; UN_ATOMIC_LOAD(&workers->active, ACQUIRE);) {
+            const uint32_t pushes = UN_ATOMIC_LOAD(&workers->pushes, SEQ_CST);
+            Epoch_enter(workers->epoch);  // Succeeds, as the slot is kept.
+            const bool worked = Worker_work(worker);
+            Epoch_exit(workers->epoch);
+            if (worked) {
+                idle = 0U;
+            } else if (++idle < UN_WORKER_SPINS) {
+                sched_yield();
+            } else {
+                idle = 0U;
+                Workers_park(workers, pushes);
+            }
+        }
+    }
+}
+
+static Workers *Workers_new(Structure *structure, Epoch *epoch,
+                            size_t count) {
+    UN_CHECK_LT(0UL, count, "zu");
+    Workers *workers = malloc_or_die(sizeof(Workers));
+    UN_CHECK(!pthread_mutex_init(&workers->lock, NULL), "mutex init failed");
+    UN_CHECK(!pthread_mutex_init(&workers->idle_lock, NULL),
+             "mutex init failed");
+    UN_CHECK(!pthread_cond_init(&workers->idle_cond, NULL),
+             "cond init failed");
+    UN_CHECK(!pthread_cond_init(&workers->work_cond, NULL),
+             "cond init failed");
+    workers->structure = structure;
+    workers->epoch = epoch;
+    workers->count = count;
+    workers->active = 0U;
+    workers->stopping = 0U;
+    workers->pushes = 0U;
+    workers->parked = 0U;
+    workers->workers =
+        memalign_or_die(UN_CACHE_LINE_BYTES, count * sizeof(Worker));
+    bzero(workers->workers, count * sizeof(Worker));
+    for (size_t i = 0; i != count; ++i) {
+        workers->workers[i].workers = workers;
+        workers->workers[i].seed = 2654435761U * (uint32_t)(i + 1UL);
+        Machine_init(&workers->workers[i].machine);
+    }
+    for (size_t i = 1; i < count; ++i) {
+        Worker *worker = workers->workers + i;
+        UN_CHECK(!pthread_create(&worker->thread, NULL, Worker_main, worker),
+                 "pthread_create failed");
+    }
+    return workers;
+}
+
+static void Workers_delete(Workers *workers) {
+    pthread_mutex_lock(&workers->idle_lock);
+    workers->stopping = 1U;
+    pthread_cond_broadcast(&workers->idle_cond);
+    pthread_cond_broadcast(&workers->work_cond);
+    pthread_mutex_unlock(&workers->idle_lock);
+    for (size_t i = 1; i < workers->count; ++i) {
+        pthread_join(workers->workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&workers->work_cond);
+    pthread_cond_destroy(&workers->idle_cond);
+    pthread_mutex_destroy(&workers->idle_lock);
+    pthread_mutex_destroy(&workers->lock);
+    for (size_t i = 0; i != workers->count; ++i) {
+        Machine_delete(&workers->workers[i].machine);
+    }
+    free(workers->workers);
+    free(workers);
+}
+
+// Wakes the pool. Must be called by the driving thread, which then owns the
+// first deque until Workers_deactivate. If the driving thread has no Epoch
+// slot, the pool stays idle and the engine runs serially under its lock.
+static void Workers_activate(Workers *workers) {
+    if (!Epoch_enter(workers->epoch)) return;
+    t_worker = workers->workers;
+    pthread_mutex_lock(&workers->idle_lock);
+    UN_ATOMIC_STORE(&workers->active, 1U, RELEASE);
+    pthread_cond_broadcast(&workers->idle_cond);
+    pthread_mutex_unlock(&workers->idle_lock);
+}
+
+static void Workers_deactivate(Workers *workers) {
+    if (!t_worker) return;  // Never activated.
+    pthread_mutex_lock(&workers->idle_lock);
+    UN_ATOMIC_STORE(&workers->active, 0U, RELEASE);
+    pthread_mutex_unlock(&workers->idle_lock);
+    t_worker = NULL;
+    Epoch_exit(workers->epoch);
+}
+
+// Returns whether a term has at least UN_PARALLEL_CUTOFF apps, counting
+// shared subterms once per occurrence. Memoized terms are never large.
+static bool Structure_is_large(const Structure *structure, Ob ob) {
+    const Carrier_Node *root = Carrier_node(&structure->carrier, ob);
+    if (root->obs[0] && root->obs[1]) {
+        const Word key = {.ob_pair = {root->obs[0], root->obs[1]}};
+        if (Hash_find_shared(&structure->hash, key)) return false;
+    }
+    Ob stack[UN_PARALLEL_CUTOFF];
+    uint32_t size = 0U;
+    uint32_t count = 0U;
+    stack[size++] = ob;
+    while (size) {
+        const Carrier_Node *node =
+            Carrier_node(&structure->carrier, stack[--size]);
+        if (!(node->obs[0] && node->obs[1])) continue;
+        if (++count == UN_PARALLEL_CUTOFF) return true;
+        stack[size++] = node->obs[0];
+        stack[size++] = node->obs[1];
+    }
+    return false;
+}
+
+// Simplifies args[begin, size) in place, sharing large ones with other
+// workers. Returns false without simplifying if fewer than two are large.
+// Args are indexed afresh after each simplification, which may grow them.
+static bool Workers_simplify_many(Workers *workers, ObStack *args,
+                                  uint32_t begin) {
+    Worker *self = t_worker;
+    UN_DCHECK_TRUE(self && self->workers == workers);
+    Structure *structure = workers->structure;
+    const size_t count = args->size - begin;
+    size_t large_count = 0;
+    for (size_t pos = 0; pos != count && large_count < 2UL; ++pos) {
+        large_count += Structure_is_large(structure, args->data[begin + pos]);
+    }
+    if (large_count < 2UL) return false;
+
+    Task tasks_on_stack[16];
+    Task *tasks = (count <= 16UL) ? tasks_on_stack
+                                  : malloc_or_die(count * sizeof(Task));
+    size_t task_count = 0;
+    for (size_t pos = 0; pos != count; ++pos) {
+        const Ob arg = args->data[begin + pos];
+        if (Structure_is_large(structure, arg)) {
+            Task *task = tasks + task_count;
+            task->ob = arg;
+            task->pos = (uint32_t)pos;
+            task->done = 0U;
+            task->sampling = 0U;
+            if (WorkDeque_push(&self->deque, task)) {
+                Workers_notify(workers);
+                ++task_count;
+                continue;
+            }
+        }
+        const Ob result = simplify(structure, arg);
+        args->data[begin + pos] = result;
+    }
+
+    // Help until our tasks are done, starting with those not yet stolen.
+    for (size_t i = task_count; i--;) {
+        while (!UN_ATOMIC_LOAD(&tasks[i].done, ACQUIRE)) {
+            if (!Worker_work(self)) sched_yield();
+        }
+        args->data[begin + tasks[i].pos] = tasks[i].ob;
+    }
+    if (tasks != tasks_on_stack) free(tasks);
+    return true;
+}
+
+// Sets out[i] to sample i of ob, for i < count, sharing samples with other
+// workers. Samples that do not fit in the deque are drawn inline.
+static void Workers_sample_many(Workers *workers, Ob ob, uint64_t seed,
+                                int budget, Ob *out, size_t count) {
+    Worker *self = t_worker;
+    UN_DCHECK_TRUE(self && self->workers == workers);
+    Task *tasks = malloc_or_die(count * sizeof(Task));
+    size_t task_count = 0;
+    for (size_t i = 0; i != count; ++i) {
+        const uint64_t key = random_draw(seed, i);
+        Task *task = tasks + task_count;
+        task->ob = ob;
+        task->pos = (uint32_t)i;
+        task->done = 0U;
+        task->sampling = 1U;
+        task->budget = budget;
+        task->key = key;
+        if (WorkDeque_push(&self->deque, task)) {
+            Workers_notify(workers);
+            ++task_count;
+        } else {
+            out[i] = sample(workers->structure, ob, key, budget);
+        }
+    }
+    for (size_t i = task_count; i--;) {
+        while (!UN_ATOMIC_LOAD(&tasks[i].done, ACQUIRE)) {
+            if (!Worker_work(self)) sched_yield();
+        }
+        out[tasks[i].pos] = tasks[i].ob;
+    }
+    free(tasks);
+}
+
+// ---------------------------------------------------------------------------
+// Reduction algorithms
+
+static inline Hash_Node *find_app(Structure *structure, Ob lhs, Ob rhs) {
+    Word key = {.uint32s = {lhs, rhs}};
+    return Hash_find(&structure->hash, key);
+}
+
+// Raises the priority of a pending ob each time it is referenced.
+static inline void reference_pending(Structure *structure, Ob ob) {
+    const uint32_t priority = ObQueue_priority(&structure->pending, ob);
+    if (priority) ObQueue_push(&structure->pending, ob, priority + 1U);
+}
+
+static Ob insert_app(Structure *structure, Ob lhs, Ob rhs) {
+    Word key = {.ob_pair = {lhs, rhs}};
+    const Hash_Node *node = Hash_find(&structure->app_LRv, key);
+    if (node) {
+        const Ob ob = UnionFind_find(&structure->reps, node->slot.val);
+        reference_pending(structure, ob);
+        return ob;
+    }
+
+    Ob ob = Carrier_alloc(&structure->carrier);
+    Carrier_Node *nodes = structure->carrier.nodes;
+    nodes[ob].obs[0] = lhs;
+    nodes[ob].obs[1] = rhs;
+    nodes[ob].vars = nodes[lhs].vars | nodes[rhs].vars;
+    Structure_insert_app(structure, lhs, rhs, ob);
+    reference_pending(structure, lhs);
+    reference_pending(structure, rhs);
+    ObQueue_push(&structure->pending, ob, 1U);
+    return ob;
+}
+
+static Ob make_app(Structure *structure, Ob lhs, Ob rhs) {
+    UN_DCHECK_TRUE(lhs);
+    UN_DCHECK_TRUE(rhs);
+    lhs = UnionFind_find(&structure->reps, lhs);
+    rhs = UnionFind_find(&structure->reps, rhs);
+    if (!structure->workers) return insert_app(structure, lhs, rhs);
+
+    // In parallel, hits are lock-free but do not raise pending priorities.
+    const Word key = {.ob_pair = {lhs, rhs}};
+    const Ob ob = Hash_find_shared(&structure->app_LRv, key);
+    if (ob) return UnionFind_find(&structure->reps, ob);
+    Structure_lock(structure);
+    const Ob app = insert_app(structure, lhs, rhs);
+    Structure_unlock(structure);
+    return app;
+}
+
+static Ob make_int(Structure *structure, int32_t value) {
+    const Word key = int_key(value);
+    if (!structure->workers) {
+        const Hash_Node *node = Hash_find(&structure->ints, key);
+        return node ? node->slot.val : Structure_insert_int(structure, value);
+    }
+
+    // In parallel, hits are lock-free as in make_app.
+    Ob ob = Hash_find_shared(&structure->ints, key);
+    if (ob) return ob;
+    Structure_lock(structure);
+    const Hash_Node *node = Hash_find(&structure->ints, key);
+    ob = node ? node->slot.val : Structure_insert_int(structure, value);
+    Structure_unlock(structure);
+    return ob;
+}
+
+// Returns the memoized simplification of an app, or 0, as Hash_find_shared.
+// Only a bounded memo marks hits for eviction, so that readers never write
+// to an unbounded one, whose pages may be shared with a snapshot.
+static inline Ob find_memo_shared(const Structure *structure, Word key) {
+    const Hash *memo = &structure->hash;
+    Ob val;
+    Hash_Node *node = Hash_find_node_shared(memo, key, &val);
+    if (!node) return 0U;
+    if (UN_ATOMIC_LOAD(&memo->max_size, RELAXED)) Hash_touch(node);
+    return val;
+}
+
+// Returns the memoized simplification of an app of reps, or 0 if absent.
+static inline Ob find_simplified(Structure *structure, Ob lhs, Ob rhs) {
+    if (structure->workers) {
+        const Word key = {.ob_pair = {lhs, rhs}};
+        const Ob val = find_memo_shared(structure, key);
+        return val ? UnionFind_find(&structure->reps, val) : 0U;
+    }
+    Hash_Node *node = find_app(structure, lhs, rhs);
+    if (!node) return 0U;
+    if (structure->hash.max_size) Hash_touch(node);
+    const Ob val = UnionFind_find(&structure->reps, node->slot.val);
+    if (val != node->slot.val) UN_ATOMIC_STORE(&node->slot.val, val, RELEASE);
+    return val;
+}
+
+enum { UN_NATIVE_NONE, UN_NATIVE_INT, UN_NATIVE_BYTE, UN_NATIVE_BOOL };
+
+// Returns the kind of a native value, or UN_NATIVE_NONE.
+static inline int native_kind(const Carrier *carrier, Ob ob) {
+    if (is_byte(ob)) return UN_NATIVE_BYTE;
+    if (is_bool(ob)) return UN_NATIVE_BOOL;
+    return Carrier_is_int(carrier, ob) ? UN_NATIVE_INT : UN_NATIVE_NONE;
+}
+
+// Applies an operator to native reps. Returns the result, or 0 if the
+// operator is undefined on their kinds. Arithmetic wraps around, as ints
+// do in two's complement and bytes do mod 256, and dividing by zero
+// diverges.
+static Ob apply_operator(Structure *structure, Ob op, Ob x, Ob y) {
+    const Carrier *carrier = &structure->carrier;
+    const int kind = native_kind(carrier, x);
+    if (kind != native_kind(carrier, y)) return 0U;
+    if (op == UN_EQ) return x == y ? UN_TRUE : UN_FALSE;  // Hash-consed.
+    if (kind == UN_NATIVE_BOOL) return 0U;
+    int64_t lhs, rhs;
+    if (kind == UN_NATIVE_INT) {
+        lhs = Carrier_int_value(carrier, x);
+        rhs = Carrier_int_value(carrier, y);
+    } else {
+        lhs = x - UN_BYTES_BEGIN;
+        rhs = y - UN_BYTES_BEGIN;
+    }
+    if (op == UN_LT) return lhs < rhs ? UN_TRUE : UN_FALSE;
+    if ((op == UN_DIV || op == UN_MOD) && !rhs) return UN_BOT;
+    int64_t result;
+    switch (op) {
+        case UN_ADD: result = lhs + rhs; break;
+        case UN_SUB: result = lhs - rhs; break;
+        case UN_MUL: result = lhs * rhs; break;
+        case UN_DIV: result = lhs / rhs; break;
+        default: result = lhs % rhs;
+    }
+    if (kind == UN_NATIVE_BYTE) return UN_BYTES_BEGIN + (Ob)(result & 0xFF);
+    return make_int(structure, (int32_t)(uint32_t)result);
+}
+
+// Checks that the arg at pos is native. If not, and the arg is an app that
+// has not been forced, marks it to be forced. Operators force each arg once
+// before giving up, so an arg whose normal form is not native is stuck.
+static inline bool force_native(const Carrier *carrier, const ObStack *args,
+                                uint32_t pos, uint32_t *forced,
+                                bool *forcing) {
+    const Ob arg = args->data[pos];
+    if (native_kind(carrier, arg)) return true;
+    if (pos != *forced && Carrier_is_app(carrier, arg)) {
+        *forced = pos;
+        *forcing = true;
+    }
+    return false;
+}
+
+typedef enum {
+    UN_HEAD_DONE,       // The head is stuck or has consumed all args.
+    UN_HEAD_SUSPENDED,  // A non-linear step is due but the budget is spent.
+    UN_HEAD_FORCING,    // The arg at *forced must be simplified first.
+} HeadState;
+
+// Head rules, indexed by atoms below UN_VARS_BEGIN and by kinds of native
+// above. Reduction dispatches on the rule of each head it unwinds.
+enum {
+    UN_RULE_STUCK = 0,  // Variables, and atoms without a rule.
+    UN_RULE_TOP = UN_TOP,
+    UN_RULE_BOT = UN_BOT,
+    UN_RULE_I = UN_I,
+    UN_RULE_K = UN_K,
+    UN_RULE_B = UN_B,
+    UN_RULE_C = UN_C,
+    UN_RULE_S = UN_S,
+    UN_RULE_J = UN_J,
+    UN_RULE_BOOL = UN_VARS_BEGIN,
+    UN_RULE_OPERATOR,
+    UN_RULE_NUMERAL,
+    UN_RULE_COUNT
+};
+
+static inline int head_rule(const Carrier *carrier, Ob head) {
+    if (head < UN_VARS_BEGIN) return (int)head;
+    if (is_var(head)) return UN_RULE_STUCK;
+    if (is_bool(head)) return UN_RULE_BOOL;
+    if (is_operator(head)) return UN_RULE_OPERATOR;
+    UN_DCHECK(is_byte(head) || Carrier_is_int(carrier, head),
+              "unidentified ob: %u", head);
+    UN_UNUSED(carrier);
+    return UN_RULE_NUMERAL;
+}
+
+// Dispatch is threaded where the compiler supports labels as values, as in
+// TIGRE [Koopman91]: each rule jumps straight to the rule of the next head,
+// rather than returning to a shared switch.
+#if defined(__GNUC__) || defined(__clang__)
+#define UN_THREADED_DISPATCH 1
+#define UN_DISPATCH(rule) goto *dispatch[rule];
+#define UN_RULE(name) rule_##name
+#else  // defined(__GNUC__) || defined(__clang__)
+#define UN_THREADED_DISPATCH 0
+#define UN_DISPATCH(rule) switch (rule)
+#define UN_RULE(name) case UN_RULE_##name
+#endif  // defined(__GNUC__) || defined(__clang__)
+
+// Counts a step and continues with the next head.
+#define UN_FIRE(index)                                  \
+    do {                                                \
+        UN_COUNT_INTO(counters, reductions[index], 1U); \
+        *forced = begin - 1U;                           \
+        goto unwind;                                    \
+    } while (0)
+
+// Reduces head applied to args[begin, size), unwinding the head's spine
+// onto args and updating head in place. Linear beta-eta steps are free.
+// Non-linear steps, of S, of J distributing over an arg, and of native
+// numerals above 1, each spend one unit of budget, and are stuck if budget
+// is NULL. While sampling, J instead chooses one of its args at random.
+// Operators on native args fire as CPU arithmetic, forcing args that are
+// apps. *forced is the position of an arg simplified since the last step,
+// or begin - 1 if none.
+//
+// Arity is counted as the spine unwinds, so each rule checks it once.
+// Frequent pairs of steps are fused into single rules, chosen by counting
+// heads and their first args over the benchmark corpus: S I, K I and S B,
+// and also S K, B I and C I, each of which avoids building an app.
+#if UN_THREADED_DISPATCH
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif  // UN_THREADED_DISPATCH
+static HeadState reduce_head(Structure *structure, Machine *machine,
+                             uint32_t begin, Ob *head_ptr, uint32_t *forced,
+                             int *budget) {
+#if UN_THREADED_DISPATCH
+    static const void *const dispatch[UN_RULE_COUNT] = {
+        [UN_RULE_STUCK] = &&rule_STUCK,
+        [UN_RULE_TOP] = &&rule_TOP,
+        [UN_RULE_BOT] = &&rule_BOT,
+        [UN_RULE_I] = &&rule_I,
+        [UN_RULE_K] = &&rule_K,
+        [UN_RULE_B] = &&rule_B,
+        [UN_RULE_C] = &&rule_C,
+        [UN_RULE_S] = &&rule_S,
+        [UN_RULE_J] = &&rule_J,
+        [UN_RULE_BOOL] = &&rule_BOOL,
+        [UN_RULE_OPERATOR] = &&rule_OPERATOR,
+        [UN_RULE_NUMERAL] = &&rule_NUMERAL,
+    };
+#endif  // UN_THREADED_DISPATCH
+    ObStack *args = &machine->args;
+    const Carrier *carrier = &structure->carrier;
+    Counters *counters = UN_STATS ? Counters_local() : NULL;
+    Ob head = *head_ptr;
+    uint32_t arity = args->size - begin;
+    HeadState state = UN_HEAD_DONE;
+    const Ob *top;  // The first arg, with the next args below it.
+
+unwind:
+    for (const Carrier_Node *node = Carrier_node(carrier, head);
+         node->obs[0] && node->obs[1]; node = Carrier_node(carrier, head)) {
+        head = node->obs[0];
+        ObStack_push(args, node->obs[1]);
+        ++arity;
+    }
+    top = args->data + args->size - 1U;
+    UN_DISPATCH(head_rule(carrier, head)) {
+        UN_RULE(STUCK):
+            goto done;
+        UN_RULE(TOP):
+        UN_RULE(BOT):
+            if (arity) UN_COUNT_INTO(counters, reductions[head], 1U);
+            args->size = begin;
+            goto done;
+        UN_RULE(I):
+            if (arity < 1U) goto done;
+            head = top[0];
+            args->size -= 1U;
+            arity -= 1U;
+            UN_FIRE(UN_I);
+        UN_RULE(K):
+            if (arity < 2U) goto done;
+            if (top[0] == UN_I && arity >= 3U) {  // K I x y = y
+                head = top[-2];
+                args->size -= 3U;
+                arity -= 3U;
+                UN_FIRE(UN_K);
+            }
+            head = top[0];
+            args->size -= 2U;
+            arity -= 2U;
+            UN_FIRE(UN_K);
+        UN_RULE(B): {
+            if (arity < 3U) goto done;
+            const Ob x = top[0];
+            const Ob y = top[-1];
+            const Ob z = top[-2];
+            if (x == UN_I) {  // B I y z = y z
+                head = y;
+                args->size -= 2U;
+                arity -= 2U;
+                UN_FIRE(UN_B);
+            }
+            head = x;
+            args->data[args->size - 3U] = make_app(structure, y, z);
+            args->size -= 2U;
+            arity -= 2U;
+            UN_FIRE(UN_B);
+        }
+        UN_RULE(C): {
+            if (arity < 3U) goto done;
+            const Ob x = top[0];
+            const Ob y = top[-1];
+            const Ob z = top[-2];
+            if (x == UN_I) {  // C I y z = z y
+                head = z;
+                args->data[args->size - 3U] = y;
+                args->size -= 2U;
+                arity -= 2U;
+                UN_FIRE(UN_C);
+            }
+            head = x;
+            args->data[args->size - 3U] = y;
+            args->data[args->size - 2U] = z;
+            args->size -= 1U;
+            arity -= 1U;
+            UN_FIRE(UN_C);
+        }
+        UN_RULE(S): {  // S is not linear, except as S K.
+            if (arity < 3U) goto done;
+            const Ob x = top[0];
+            const Ob y = top[-1];
+            const Ob z = top[-2];
+            if (x == UN_K) {  // S K y z = K z (y z) = z
+                head = z;
+                args->size -= 3U;
+                arity -= 3U;
+                UN_FIRE(UN_S);
+            }
+            if (!budget) goto done;
+            if (*budget <= 0) {
+                state = UN_HEAD_SUSPENDED;
+                goto done;
+            }
+            --*budget;
+            if (x == UN_I) {  // S I y z = z (y z)
+                head = z;
+                args->data[args->size - 3U] = make_app(structure, y, z);
+                args->size -= 2U;
+                arity -= 2U;
+                UN_FIRE(UN_S);
+            }
+            if (x == UN_B && arity >= 4U) {  // S B y z w = z (y z w)
+                const Ob w = top[-3];
+                head = z;
+                args->data[args->size - 4U] =
+                    make_app(structure, make_app(structure, y, z), w);
+                args->size -= 3U;
+                arity -= 3U;
+                UN_FIRE(UN_S);
+            }
+            head = x;
+            args->data[args->size - 3U] = make_app(structure, y, z);
+            args->data[args->size - 2U] = z;
+            args->size -= 1U;
+            arity -= 1U;
+            UN_FIRE(UN_S);
+        }
+        UN_RULE(J): {
+            if (arity < 2U) goto done;
+            const Ob x = top[0];
+            const Ob y = top[-1];
+            if (x == UN_TOP || y == UN_TOP) {  // TOP absorbs.
+                head = UN_TOP;
+                args->size -= 2U;
+                arity -= 2U;
+                UN_FIRE(UN_J);
+            }
+            if (x == UN_BOT || y == UN_BOT || x == y) {  // Units, idem.
+                head = x == UN_BOT ? y : x;
+                args->size -= 2U;
+                arity -= 2U;
+                UN_FIRE(UN_J);
+            }
+            if (machine->sampling) {
+                const uint64_t draw = random_draw(machine->sample_key,
+                                                  machine->sample_draws++);
+                head = (draw >> 63U) ? y : x;
+                args->size -= 2U;
+                arity -= 2U;
+                UN_FIRE(UN_J);
+            }
+            // J x y z = J (x z) (y z) is not linear.
+            if (arity < 3U || !budget) goto done;
+            if (*budget <= 0) {
+                state = UN_HEAD_SUSPENDED;
+                goto done;
+            }
+            --*budget;
+            const Ob z = top[-2];
+            args->data[args->size - 3U] = make_app(structure, y, z);
+            args->data[args->size - 2U] = make_app(structure, x, z);
+            args->size -= 1U;
+            arity -= 1U;
+            UN_FIRE(UN_J);
+        }
+        UN_RULE(BOOL):  // TRUE x y = x, as K, and FALSE x y = y, as K I.
+            if (arity < 2U) goto done;
+            head = head == UN_TRUE ? top[0] : top[-1];
+            args->size -= 2U;
+            arity -= 2U;
+            UN_FIRE(0);
+        UN_RULE(OPERATOR): {
+            const uint32_t pos = args->size - 1U;
+            bool forcing = false;
+            if (arity < 2U ||
+                !force_native(carrier, args, pos, forced, &forcing) ||
+                !force_native(carrier, args, pos - 1U, forced, &forcing)) {
+                if (forcing) state = UN_HEAD_FORCING;
+                goto done;
+            }
+            const Ob result = apply_operator(structure, head, top[0],
+                                             top[-1]);
+            if (!result) goto done;
+            head = result;
+            args->size -= 2U;
+            arity -= 2U;
+            UN_FIRE(0);
+        }
+        UN_RULE(NUMERAL): {  // A native numeral n acts as a Church numeral.
+            const int64_t n = is_byte(head)
+                                  ? (int64_t)(head - UN_BYTES_BEGIN)
+                                  : Carrier_int_value(carrier, head);
+            if (n < 0 || arity < 2U) goto done;
+            const Ob f = top[0];
+            Ob x = top[-1];
+            if (n >= 2) {  // Unfolding n f x = f ((n-1) f x) copies f.
+                if (!budget) goto done;
+                if (*budget <= 0) {
+                    state = UN_HEAD_SUSPENDED;
+                    goto done;
+                }
+                --*budget;
+                const Ob pred = is_byte(head)
+                                    ? head - 1U
+                                    : make_int(structure, (int32_t)n - 1);
+                x = make_app(structure, make_app(structure, pred, f), x);
+            }
+            args->size -= 2U;
+            arity -= 2U;
+            if (n == 0) {
+                head = x;
+                UN_FIRE(0);
+            }
+            head = f;
+            ObStack_push(args, x);
+            ++arity;
+            UN_FIRE(0);
+        }
+    }
+done:
+    *head_ptr = head;
+    return state;
+}
+#if UN_THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#endif  // UN_THREADED_DISPATCH
+
+#undef UN_FIRE
+#undef UN_RULE
+#undef UN_DISPATCH
+
+// Begins simplifying an app. If memoized, returns the memoized value if any.
+// Otherwise returns 0 after pushing a frame to reduce the app.
+static Ob Machine_enter(Structure *structure, Machine *machine, Ob lhs,
+                        Ob rhs, bool memoized) {
+    UN_DCHECK_TRUE(lhs);
+    UN_DCHECK_TRUE(rhs);
+    lhs = UnionFind_find(&structure->reps, lhs);
+    rhs = UnionFind_find(&structure->reps, rhs);
+    if (memoized) {
+        const Ob val = find_simplified(structure, lhs, rhs);
+        if (val) {
+            UN_COUNT(memo_hits, 1U);
+            return val;
+        }
+        UN_COUNT(memo_misses, 1U);
+    }
+    ObStack *args = &machine->args;
+    Frame *frame = Machine_push(machine);
+    frame->lhs = lhs;
+    frame->rhs = rhs;
+    frame->head = lhs;
+    frame->args_begin = args->size;
+    frame->args_end = UN_FRAME_REDUCING;
+    frame->arg_pos = args->size - 1U;  // No arg is forced yet.
+    ObStack_push(args, rhs);
+    return 0U;
+}
+
+// Pops a frame whose args are simplified, memoizing and returning its value.
+static Ob Machine_exit(Structure *structure, Machine *machine) {
+    const Frame *frame = Machine_top(machine);
+    UN_DCHECK_EQ(frame->arg_pos, frame->args_end, "u");
+    const Ob lhs = frame->lhs;
+    const Ob rhs = frame->rhs;
+    Ob head = frame->head;
+    ObStack *args = &machine->args;
+    while (args->size != frame->args_begin) {
+        head = make_app(structure, head, ObStack_try_pop(args));
+    }
+    --machine->frame_count;
+
+    // Save value, unless it is one of many samples.
+    if (machine->sampling) return head;
+    Structure_lock(structure);
+    if (!find_app(structure, lhs, rhs)) {
+        Hash_Node node_to_insert = {.uint32s = {lhs, rhs, head}};
+        if (structure->hash.max_size) {
+            node_to_insert.slot.spare[UN_HASH_REFERENCED] = 1U;
+        }
+        Hash_insert(&structure->hash, &node_to_insert);
+    }
+    {
+        Word key = {.ob_pair = {lhs, rhs}};
+        const Hash_Node *node = Hash_find(&structure->app_LRv, key);
+        if (node) ObQueue_remove(&structure->pending, node->slot.val);
+    }
+    Structure_unlock(structure);
+    return head;
+}
+
+// Runs a machine until its frame count returns to base, descending into
+// args depth-first, and returns the value of the last frame popped. Runs
+// may nest, as when a worker helps others while waiting. If budget is NULL,
+// this simplifies using the memo. Otherwise it computes without reading the
+// memo, and if the budget is spent either stops with S stuck or, if
+// resumable, returns 0 leaving the machine ready to run again.
+static Ob Machine_run(Structure *structure, Machine *machine, uint32_t base,
+                      int *budget, bool resumable) {
+    ObStack *args = &machine->args;
+    for (;;) {
+        Frame *frame = Machine_top(machine);
+        if (frame->args_end == UN_FRAME_REDUCING) {
+            Ob head = frame->head;
+            const HeadState state =
+                reduce_head(structure, machine, frame->args_begin, &head,
+                            &frame->arg_pos, budget);
+            frame->head = head;
+            if (state == UN_HEAD_FORCING) {
+                // Simplify the forced arg, then resume reducing.
+                const Ob arg = args->data[frame->arg_pos];
+                const Carrier_Node *node =
+                    Carrier_node(&structure->carrier, arg);
+                const Ob val = Machine_enter(structure, machine, node->obs[0],
+                                             node->obs[1], !budget);
+                if (val) args->data[Machine_top(machine)->arg_pos] = val;
+                continue;
+            }
+            if (state == UN_HEAD_SUSPENDED && resumable) return 0U;
+            frame->args_end = args->size;
+            frame->arg_pos = frame->args_begin;
+
+            // Simplify args in parallel when possible.
+            if (!budget && structure->workers && t_worker &&
+                args->size - frame->args_begin >= 2U &&
+                Workers_simplify_many(structure->workers, args,
+                                      frame->args_begin)) {
+                Machine_top(machine)->arg_pos = Machine_top(machine)->args_end;
+            }
+            continue;
+        }
+        if (frame->arg_pos != frame->args_end) {
+            const Ob arg = args->data[frame->arg_pos];
+            const Carrier_Node *node = Carrier_node(&structure->carrier, arg);
+            const Ob arg_lhs = node->obs[0];
+            const Ob arg_rhs = node->obs[1];
+            if (arg_lhs && arg_rhs) {
+                const bool memoized = !budget;
+                const Ob val = Machine_enter(structure, machine, arg_lhs,
+                                             arg_rhs, memoized);
+                if (!val) continue;  // Descend into the new frame.
+                args->data[frame->arg_pos] = val;
+            }
+            ++frame->arg_pos;
+            continue;
+        }
+        const Ob result = Machine_exit(structure, machine);
+        if (machine->frame_count == base) return result;
+        frame = Machine_top(machine);
+        if (frame->args_end == UN_FRAME_REDUCING) {
+            args->data[frame->arg_pos] = result;  // A forced arg.
+        } else {
+            args->data[frame->arg_pos++] = result;
+        }
+    }
+}
+
+static inline Machine *Structure_machine(Structure *structure) {
+    return t_worker ? &t_worker->machine : &structure->machine;
+}
+
+static Ob simplify_app(Structure *structure, Ob lhs, Ob rhs) {
+    Machine *machine = Structure_machine(structure);
+    const uint32_t base = machine->frame_count;
+    const Ob val = Machine_enter(structure, machine, lhs, rhs, true);
+    return val ? val : Machine_run(structure, machine, base, NULL, false);
+}
+
+// Reduces an app, including S steps while budget remains, then finishes
+// linearly once the budget is spent.
+static Ob compute_app(Structure *structure, Ob lhs, Ob rhs, int *budget) {
+    if (unlikely(*budget <= 0)) return simplify_app(structure, lhs, rhs);
+    Machine *machine = Structure_machine(structure);
+    const uint32_t base = machine->frame_count;
+    Machine_enter(structure, machine, lhs, rhs, false);
+    return Machine_run(structure, machine, base, budget, false);
+}
+
+// Like compute_app, but when the budget is spent, saves the computation to
+// a suspension and returns 0.
+static Ob compute_app_resumable(Structure *structure, Ob lhs, Ob rhs,
+                                int *budget, Suspension *suspension) {
+    Machine *machine = Structure_machine(structure);
+    const uint32_t base = machine->frame_count;
+    Machine_enter(structure, machine, lhs, rhs, false);
+    const Ob result = Machine_run(structure, machine, base, budget, true);
+    if (!result) Machine_suspend(machine, base, suspension);
+    return result;
+}
+
+// Continues a suspended computation, returning its result or 0 if it was
+// suspended again.
+static Ob compute_resume(Structure *structure, int *budget,
+                         Suspension *suspension) {
+    Machine *machine = Structure_machine(structure);
+    const uint32_t base = machine->frame_count;
+    Machine_resume(machine, suspension);
+    const Ob result = Machine_run(structure, machine, base, budget, true);
+    if (!result) Machine_suspend(machine, base, suspension);
+    return result;
+}
+
+#define UN_BATCH_SIZE 64U  // Apps probed together by batch operations.
+
+// Canonicalizes a chunk of apps into pairs, prefetching first their reps and
+// then their home lines in a hash.
+static void prefetch_app_chunk(Structure *structure, const Hash *hash,
+                               const Ob *lhs, const Ob *rhs, ObPair *pairs,
+                               size_t size) {
+    UnionFind *reps = &structure->reps;
+    for (size_t i = 0; i != size; ++i) {
+        UN_DCHECK_TRUE(lhs[i] && rhs[i]);
+        if (lhs[i] < reps->capacity) prefetch(reps->parents + lhs[i]);
+        if (rhs[i] < reps->capacity) prefetch(reps->parents + rhs[i]);
+    }
+    for (size_t i = 0; i != size; ++i) {
+        pairs[i].lhs = UnionFind_find(reps, lhs[i]);
+        pairs[i].rhs = UnionFind_find(reps, rhs[i]);
+        const Word key = {.ob_pair = pairs[i]};
+        Hash_prefetch(hash, key);
+    }
+}
+
+// Simplifies many apps, overlapping the cache misses of their memo probes.
+// Each chunk is canonicalized and its home lines prefetched, then hits are
+// resolved, and only then are misses reduced.
+static void simplify_app_batch(Structure *structure, const Ob *lhs,
+                               const Ob *rhs, Ob *out, size_t count) {
+    ObPair pairs[UN_BATCH_SIZE];
+    for (size_t begin = 0; begin < count; begin += UN_BATCH_SIZE) {
+        const size_t size =
+            count - begin < UN_BATCH_SIZE ? count - begin : UN_BATCH_SIZE;
+        prefetch_app_chunk(structure, &structure->hash, lhs + begin,
+                           rhs + begin, pairs, size);
+        Ob *chunk_out = out + begin;
+        size_t hits = 0;
+        for (size_t i = 0; i != size; ++i) {
+            chunk_out[i] =
+                find_simplified(structure, pairs[i].lhs, pairs[i].rhs);
+            hits += chunk_out[i] != 0U;
+        }
+        UN_COUNT(memo_hits, hits);
+        for (size_t i = 0; i != size; ++i) {
+            // Misses are counted when simplify_app probes again.
+            if (!chunk_out[i]) {
+                chunk_out[i] = simplify_app(structure, pairs[i].lhs,
+                                            pairs[i].rhs);
+            }
+        }
+    }
+}
+
+// Builds many apps, overlapping the cache misses of their app_LRv probes.
+static void make_app_batch(Structure *structure, const Ob *lhs,
+                           const Ob *rhs, Ob *out, size_t count) {
+    ObPair pairs[UN_BATCH_SIZE];
+    for (size_t begin = 0; begin < count; begin += UN_BATCH_SIZE) {
+        const size_t size =
+            count - begin < UN_BATCH_SIZE ? count - begin : UN_BATCH_SIZE;
+        prefetch_app_chunk(structure, &structure->app_LRv, lhs + begin,
+                           rhs + begin, pairs, size);
+        for (size_t i = 0; i != size; ++i) {
+            out[begin + i] = make_app(structure, pairs[i].lhs, pairs[i].rhs);
+        }
+    }
+}
+
+static Ob simplify(Structure *structure, Ob ob) {
+    const Carrier_Node *node = Carrier_node(&structure->carrier, ob);
+    const Ob lhs = node->obs[0];
+    const Ob rhs = node->obs[1];
+    return (lhs && rhs) ? simplify_app(structure, lhs, rhs) : ob;
+}
+
+static Ob compute(Structure *structure, Ob ob, int *budget) {
+    const Ob lhs = structure->carrier.nodes[ob].obs[0];
+    const Ob rhs = structure->carrier.nodes[ob].obs[1];
+    return (lhs && rhs) ? compute_app(structure, lhs, rhs, budget) : ob;
+}
+
+// Computes one reduction path of ob, in which each J chooses an arg by the
+// stream of key. Samples neither read nor write the memo, since an app may
+// reduce differently each time it recurs.
+static Ob sample(Structure *structure, Ob ob, uint64_t key, int budget) {
+    const Ob lhs = structure->carrier.nodes[ob].obs[0];
+    const Ob rhs = structure->carrier.nodes[ob].obs[1];
+    if (!(lhs && rhs)) return ob;
+    Machine *machine = Structure_machine(structure);
+    UN_DCHECK(!machine->sampling, "samples do not nest");
+    const uint32_t base = machine->frame_count;
+    machine->sampling = true;
+    machine->sample_key = key;
+    machine->sample_draws = 0UL;
+    Machine_enter(structure, machine, lhs, rhs, false);
+    const Ob result = Machine_run(structure, machine, base, &budget, false);
+    machine->sampling = false;
+    return result;
+}
+
+// Simplifies pending apps in order of priority, most referenced first,
+// merging each app into its simplified form. Returns the number of apps
+// simplified.
+static size_t reduce_pending(Structure *structure, size_t max_count) {
+    size_t count = 0;
+    for (Ob ob; count != max_count &&
+                (ob = ObQueue_try_pop(&structure->pending));
+         ++count) {
+        Structure_merge(structure, ob, simplify(structure, ob));
+    }
+    Structure_process_merges(structure);
+    return count;
+}
+
+// Checks that term depth is not limited by the C stack.
+static void simplify_deep_test(unsigned int seed) {
+    UN_UNUSED(seed);
+    enum { depth = 1 << 18 };
+    const Ob x = UN_VARS_BEGIN;
+    const Ob y = UN_VARS_BEGIN + 1U;
+    Structure structure;
+    Structure_init(&structure, 1UL);
+
+    // Simplify x (I (x (I ... y))) to x (x ... y).
+    Ob term = y;
+    for (size_t i = 0; i != depth; ++i) {
+        term = make_app(&structure, x, make_app(&structure, UN_I, term));
+    }
+    Ob ob = simplify(&structure, term);
+    for (size_t i = 0; i != depth; ++i) {
+        const Carrier_Node *node = structure.carrier.nodes + ob;
+        UN_CHECK_EQ(node->obs[0], x, "u");
+        ob = node->obs[1];
+    }
+    UN_CHECK_EQ(ob, y, "u");
+    UN_CHECK_EQ(structure.machine.frame_count, 0U, "u");
+    UN_CHECK_EQ(structure.machine.args.size, 0U, "u");
+    Structure_clear(&structure);
+}
+
+// ---------------------------------------------------------------------------
+// Abstraction
+//
+// Bracket abstraction \x.M eliminates a variable x from a term M, so that
+// (\x.M) x = M, by the rules
+//   \x.M     = K M                  if x is not free in M
+//   \x.x     = I
+//   \x.M x   = M                    if x is not free in M
+//   \x.M N   = B M (\x.N)           if x is not free in M
+//   \x.M N   = C (\x.M) N           if x is not free in N
+//   \x.M N   = S (\x.M) (\x.N)
+// Each node caches its free variables, so the first rule costs O(1). Other
+// abstractions are memoized in abs_LRv by variable and body, so shared
+// subterms are abstracted once. Merges rewrite bodies to their reps, so
+// abstraction walks the app structure of M as built, which is acyclic,
+// and looks up each subterm by its rep.
+
+static inline bool is_free_in(const Structure *structure, Ob var, Ob ob) {
+    return structure->carrier.nodes[ob].vars & (1U << (var - UN_VARS_BEGIN));
+}
+
+// Returns \var.ob if it is I or memoized, or 0 otherwise.
+static Ob find_abstraction(Structure *structure, Ob var, Ob ob) {
+    UnionFind *reps = &structure->reps;
+    ob = UnionFind_find(reps, ob);
+    if (ob == var) return UN_I;
+    Word key = {.ob_pair = {var, ob}};
+    const Hash_Node *node = Hash_find(&structure->abs_LRv, key);
+    return node ? UnionFind_find(reps, node->slot.val) : 0U;
+}
+
+static Ob abstract(Structure *structure, Ob var, Ob ob) {
+    UN_DCHECK_TRUE(is_var(var));
+    if (!is_free_in(structure, var, ob)) return make_app(structure, UN_K, ob);
+    Ob result = find_abstraction(structure, var, ob);
+    if (result) return result;
+
+    // Abstract subterms in post-order, without recursion.
+    ObStack *stack = &Structure_machine(structure)->args;
+    const uint32_t base = stack->size;
+    ObStack_push(stack, ob);
+    while (stack->size != base) {
+        const Ob body = stack->data[stack->size - 1U];
+        if (find_abstraction(structure, var, body)) {
+            ObStack_try_pop(stack);
+            continue;
+        }
+        const Ob lhs = structure->carrier.nodes[body].obs[0];
+        const Ob rhs = structure->carrier.nodes[body].obs[1];
+        UN_DCHECK(lhs && rhs, "expected an app");
+        const bool lhs_free = is_free_in(structure, var, lhs);
+        const bool rhs_free = is_free_in(structure, var, rhs);
+        const Ob lhs_abs =
+            lhs_free ? find_abstraction(structure, var, lhs) : 0U;
+        const Ob rhs_abs =
+            rhs_free ? find_abstraction(structure, var, rhs) : 0U;
+        if (lhs_free && !lhs_abs) ObStack_push(stack, lhs);
+        if (rhs_free && !rhs_abs) ObStack_push(stack, rhs);
+        if (stack->data[stack->size - 1U] != body) continue;
+        ObStack_try_pop(stack);
+
+        Ob val;
+        if (!lhs_free && rhs_abs == UN_I) {
+            val = lhs;
+        } else if (!lhs_free) {
+            val = make_app(structure, make_app(structure, UN_B, lhs), rhs_abs);
+        } else if (!rhs_free) {
+            val = make_app(structure, make_app(structure, UN_C, lhs_abs), rhs);
+        } else {
+            val = make_app(structure, make_app(structure, UN_S, lhs_abs),
+                           rhs_abs);
+        }
+        Structure_insert_abs(structure, var,
+                             UnionFind_find(&structure->reps, body), val);
+    }
+    return find_abstraction(structure, var, ob);
+}
+
+// Checks that term depth is not limited by the C stack.
+static void abstract_deep_test(unsigned int seed) {
+    UN_UNUSED(seed);
+    enum { depth = 1 << 16 };
+    const Ob x = UN_VARS_BEGIN;
+    const Ob y = UN_VARS_BEGIN + 1U;
+    Structure structure;
+    Structure_init(&structure, 1UL);
+
+    // Abstract x from y (x (y (x ... x))), then apply it back to x.
+    Ob term = x;
+    for (size_t i = 0; i != depth; ++i) {
+        term = make_app(&structure, y, make_app(&structure, x, term));
+    }
+    const Ob abs = abstract(&structure, x, term);
+    UN_CHECK(!is_free_in(&structure, x, abs), "%u is free", x);
+    UN_CHECK_EQ(structure.machine.args.size, 0U, "u");
+    UN_CHECK_EQ(abstract(&structure, x, term), abs, "u");
+    int budget = 4 * depth;
+    UN_CHECK_EQ(compute(&structure, make_app(&structure, abs, x), &budget),
+                term, "u");
+    Structure_validate(&structure);
+    Structure_clear(&structure);
+}
+
+// ---------------------------------------------------------------------------
+// Snapshot
+//
+// A snapshot is a header followed by the raw arrays of a Structure, each
+// aligned to a cache line, in host byte order. Opening a snapshot maps it
+// copy-on-write and points the Structure's arrays into the mapping, so
+// lookups are served immediately and pages are read in as they are touched.
+// The only pointers in these arrays are AbsList nodes, which are stored as
+// offsets into a payload section and patched when opened. Opening checks the
+// layout of a snapshot but trusts its contents.
+
+#define UN_SNAPSHOT_MAGIC "hstarsnp"
+#define UN_SNAPSHOT_VERSION 5U
+#define UN_SNAPSHOT_BYTE_ORDER 0x01020304U
+
+enum {
+    UN_SNAPSHOT_CARRIER,
+    UN_SNAPSHOT_ABS_INDEX,
+    UN_SNAPSHOT_ABS_PAYLOAD,
+    UN_SNAPSHOT_HASH,
+    UN_SNAPSHOT_APP_LRV,
+    UN_SNAPSHOT_ABS_LRV,
+    UN_SNAPSHOT_INTS,
+    UN_SNAPSHOT_APP_LRV_PAGES,
+    UN_SNAPSHOT_APP_LRV_HEADS,
+    UN_SNAPSHOT_APP_RLV_PAGES,
+    UN_SNAPSHOT_APP_RLV_HEADS,
+    UN_SNAPSHOT_APP_VLR_PAGES,
+    UN_SNAPSHOT_APP_VLR_HEADS,
+    UN_SNAPSHOT_ABS_LRV_PAGES,
+    UN_SNAPSHOT_ABS_LRV_HEADS,
+    UN_SNAPSHOT_ABS_VLR_PAGES,
+    UN_SNAPSHOT_ABS_VLR_HEADS,
+    UN_SNAPSHOT_PENDING_HEAP,
+    UN_SNAPSHOT_PENDING_POSITIONS,
+    UN_SNAPSHOT_REPS,
+    UN_SNAPSHOT_SECTION_COUNT
+};
+
+#define UN_SNAPSHOT_HASH_COUNT 4
+#define UN_SNAPSHOT_INVERSE_COUNT 5
+
+typedef struct {
+    uint64_t offset;
+    uint64_t bytes;
+} Snapshot_Section;
+
+typedef struct {
+    Ob ob;
+    uint32_t size;
+    uint64_t offset;  // In bytes, from the start of the payload section.
+} Snapshot_AbsEntry;
+
+typedef struct {
+    uint64_t count;
+    uint32_t key_capacity;
+    uint32_t page_free_range;
+    uint32_t page_free_list;
+    uint32_t page_capacity;
+} Snapshot_InverseHash;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_bytes;
+    Ob carrier_free_range;
+    Ob carrier_free_list;
+    Ob carrier_capacity;
+    Ob reps_capacity;
+    uint64_t hash_counts[UN_SNAPSHOT_HASH_COUNT];
+    Snapshot_InverseHash inverses[UN_SNAPSHOT_INVERSE_COUNT];
+    uint32_t pending_size;
+    uint32_t pending_capacity;
+    Ob pending_ob_capacity;
+    uint32_t abs_count;
+    Snapshot_Section sections[UN_SNAPSHOT_SECTION_COUNT];
+} Snapshot_Header;
+
+static inline void Structure_hashes(
+    const Structure *structure, const Hash *hashes[UN_SNAPSHOT_HASH_COUNT]) {
+    hashes[0] = &structure->hash;
+    hashes[1] = &structure->app_LRv;
+    hashes[2] = &structure->abs_LRv;
+    hashes[3] = &structure->ints;
+}
+
+static inline void Structure_inverses(
+    const Structure *structure,
+    const InverseHash *inverses[UN_SNAPSHOT_INVERSE_COUNT]) {
+    inverses[0] = &structure->app_Lrv;
+    inverses[1] = &structure->app_Rlv;
+    inverses[2] = &structure->app_Vlr;
+    inverses[3] = &structure->abs_Lrv;
+    inverses[4] = &structure->abs_Vlr;
+}
+
+static int write_all_at(int fd, const void *data, size_t bytes, off_t offset) {
+    if (lseek(fd, offset, SEEK_SET) < 0) return errno;
+    const char *pos = data;
+    while (bytes) {
+        const ssize_t written = write(fd, pos, bytes);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        pos += written;
+        bytes -= (size_t)written;
+    }
+    return 0;
+}
+
+// Fills in the header's sections, laying them out after the header.
+static void Snapshot_Header_layout(Snapshot_Header *header) {
+    uint64_t offset = sizeof(Snapshot_Header);
+    for (int i = 0; i != UN_SNAPSHOT_SECTION_COUNT; ++i) {
+        offset = (offset + UN_CACHE_LINE_BYTES - 1UL) &
+                 ~(UN_CACHE_LINE_BYTES - 1UL);
+        header->sections[i].offset = offset;
+        offset += header->sections[i].bytes;
+    }
+    header->file_bytes = offset;
+}
+
+// Writes a snapshot to fd. Returns 0 on success, or an errno value. This
+// allocates nothing, so it is safe to call in a child after fork.
+static int Structure_save(const Structure *structure, int fd) {
+    UN_CHECK_EQ(structure->merges.size, 0U, "u");
+    const Carrier *carrier = &structure->carrier;
+    const Hash *hashes[UN_SNAPSHOT_HASH_COUNT];
+    const InverseHash *inverses[UN_SNAPSHOT_INVERSE_COUNT];
+    Structure_hashes(structure, hashes);
+    Structure_inverses(structure, inverses);
+    for (int i = 0; i != UN_SNAPSHOT_HASH_COUNT; ++i) {
+        UN_CHECK(!hashes[i]->old_nodes, "hash %d is growing", i);
+    }
+
+    Snapshot_Header header;
+    bzero(&header, sizeof(header));
+    memcpy(header.magic, UN_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = UN_SNAPSHOT_VERSION;
+    header.byte_order = UN_SNAPSHOT_BYTE_ORDER;
+    header.carrier_free_range = carrier->free_range;
+    header.carrier_free_list = carrier->free_list;
+    // Spare capacity is not saved; opened engines grow on demand.
+    header.carrier_capacity = carrier->free_range;
+    header.reps_capacity = structure->reps.capacity;
+    header.pending_size = structure->pending.size;
+    header.pending_capacity =
+        structure->pending.size ? structure->pending.size : 1U;
+    header.pending_ob_capacity = structure->pending.ob_capacity;
+    Snapshot_Section *sections = header.sections;
+    sections[UN_SNAPSHOT_CARRIER].bytes =
+        header.carrier_capacity * sizeof(Carrier_Node);
+    uint64_t payload_bytes = 0;
+    for (Ob ob = 1U; ob < carrier->free_range; ++ob) {
+        const AbsList *abs = &carrier->nodes[ob].abs;
+        if (!AbsList_is_inline(abs)) {
+            ++header.abs_count;
+            payload_bytes +=
+                AbsList_capacity(abs->outline.size) * sizeof(AbsList_Node);
+        }
+    }
+    sections[UN_SNAPSHOT_ABS_INDEX].bytes =
+        header.abs_count * sizeof(Snapshot_AbsEntry);
+    sections[UN_SNAPSHOT_ABS_PAYLOAD].bytes = payload_bytes;
+    for (int i = 0; i != UN_SNAPSHOT_HASH_COUNT; ++i) {
+        header.hash_counts[i] = hashes[i]->count;
+        sections[UN_SNAPSHOT_HASH + i].bytes =
+            hashes[i]->size * sizeof(Hash_Node);
+    }
+    for (int i = 0; i != UN_SNAPSHOT_INVERSE_COUNT; ++i) {
+        Snapshot_InverseHash *info = header.inverses + i;
+        info->count = inverses[i]->count;
+        info->key_capacity = inverses[i]->key_capacity;
+        info->page_free_range = inverses[i]->page_free_range;
+        info->page_free_list = inverses[i]->page_free_list;
+        info->page_capacity = inverses[i]->page_free_range;
+        sections[UN_SNAPSHOT_APP_LRV_PAGES + 2 * i].bytes =
+            info->page_capacity * sizeof(InverseHash_Page);
+        sections[UN_SNAPSHOT_APP_LRV_HEADS + 2 * i].bytes =
+            inverses[i]->key_capacity * sizeof(uint32_t);
+    }
+    sections[UN_SNAPSHOT_PENDING_HEAP].bytes =
+        header.pending_capacity * sizeof(ObQueue_Entry);
+    sections[UN_SNAPSHOT_PENDING_POSITIONS].bytes =
+        structure->pending.ob_capacity * sizeof(uint32_t);
+    sections[UN_SNAPSHOT_REPS].bytes = structure->reps.capacity * sizeof(Ob);
+    Snapshot_Header_layout(&header);
+
+    int error;
+    if (ftruncate(fd, (off_t)header.file_bytes)) return errno;
+    if ((error = write_all_at(fd, &header, sizeof(header), 0))) return error;
+
+    // Write carrier nodes in chunks, replacing AbsList pointers by offsets.
+    {
+        Carrier_Node chunk[64];
+        Snapshot_AbsEntry entry;
+        uint64_t abs_pos = 0;
+        uint64_t payload_pos = 0;
+        off_t offset = (off_t)sections[UN_SNAPSHOT_CARRIER].offset;
+        for (Ob begin = 0; begin < carrier->free_range; begin += 64U) {
+            const Ob end = begin + 64U < carrier->free_range
+                               ? begin + 64U
+                               : carrier->free_range;
+            memcpy(chunk, carrier->nodes + begin,
+                   (end - begin) * sizeof(Carrier_Node));
+            for (Ob ob = begin; ob != end; ++ob) {
+                AbsList *abs = &chunk[ob - begin].abs;
+                if (AbsList_is_inline(abs)) continue;
+                const size_t bytes = abs->outline.size * sizeof(AbsList_Node);
+                entry.ob = ob;
+                entry.size = abs->outline.size;
+                entry.offset = payload_pos;
+                if ((error = write_all_at(
+                         fd, abs->outline.nodes, bytes,
+                         (off_t)(sections[UN_SNAPSHOT_ABS_PAYLOAD].offset +
+                                 payload_pos)))) {
+                    return error;
+                }
+                if ((error = write_all_at(
+                         fd, &entry, sizeof(entry),
+                         (off_t)(sections[UN_SNAPSHOT_ABS_INDEX].offset +
+                                 abs_pos)))) {
+                    return error;
+                }
+                // Pad to capacity, so that mapped lists can be recycled.
+                payload_pos +=
+                    AbsList_capacity(entry.size) * sizeof(AbsList_Node);
+                abs_pos += sizeof(entry);
+                abs->outline.nodes = NULL;
+            }
+            const size_t bytes = (end - begin) * sizeof(Carrier_Node);
+            if ((error = write_all_at(fd, chunk, bytes, offset))) return error;
+            offset += (off_t)bytes;
+        }
+    }
+
+    const void *arrays[UN_SNAPSHOT_SECTION_COUNT] = {NULL};
+    for (int i = 0; i != UN_SNAPSHOT_HASH_COUNT; ++i) {
+        arrays[UN_SNAPSHOT_HASH + i] = hashes[i]->nodes;
+    }
+    for (int i = 0; i != UN_SNAPSHOT_INVERSE_COUNT; ++i) {
+        arrays[UN_SNAPSHOT_APP_LRV_PAGES + 2 * i] = inverses[i]->pages;
+        arrays[UN_SNAPSHOT_APP_LRV_HEADS + 2 * i] = inverses[i]->heads;
+    }
+    arrays[UN_SNAPSHOT_PENDING_HEAP] = structure->pending.heap;
+    arrays[UN_SNAPSHOT_PENDING_POSITIONS] = structure->pending.positions;
+    arrays[UN_SNAPSHOT_REPS] = structure->reps.parents;
+    for (int i = UN_SNAPSHOT_HASH; i != UN_SNAPSHOT_SECTION_COUNT; ++i) {
+        if (!sections[i].bytes) continue;
+        if ((error = write_all_at(fd, arrays[i], sections[i].bytes,
+                                (off_t)sections[i].offset))) {
+            return error;
+        }
+    }
+    return fsync(fd) ? errno : 0;
+}
+
+static inline void *Snapshot_data(const char *base, int section) {
+    const Snapshot_Header *header = (const Snapshot_Header *)base;
+    return (void *)(uintptr_t)(base + header->sections[section].offset);
+}
+
+// Checks that a mapped snapshot is well formed. Returns 0 or an errno value.
+static int Snapshot_validate(const char *base, size_t file_bytes) {
+    if (file_bytes < sizeof(Snapshot_Header)) return EINVAL;
+    const Snapshot_Header *header = (const Snapshot_Header *)base;
+    if (memcmp(header->magic, UN_SNAPSHOT_MAGIC, sizeof(header->magic))) {
+        return EINVAL;
+    }
+    if (header->version != UN_SNAPSHOT_VERSION) return ENOTSUP;
+    if (header->byte_order != UN_SNAPSHOT_BYTE_ORDER) return ENOTSUP;
+    if (header->file_bytes != file_bytes) return EINVAL;
+
+    const Snapshot_Section *sections = header->sections;
+    for (int i = 0; i != UN_SNAPSHOT_SECTION_COUNT; ++i) {
+        if (sections[i].offset % UN_CACHE_LINE_BYTES) return EINVAL;
+        if (sections[i].offset > file_bytes) return EINVAL;
+        if (sections[i].bytes > file_bytes - sections[i].offset) return EINVAL;
+    }
+    if (!header->carrier_capacity ||
+        header->carrier_free_range > header->carrier_capacity ||
+        sections[UN_SNAPSHOT_CARRIER].bytes !=
+            header->carrier_capacity * sizeof(Carrier_Node) ||
+        sections[UN_SNAPSHOT_ABS_INDEX].bytes !=
+            header->abs_count * sizeof(Snapshot_AbsEntry)) {
+        return EINVAL;
+    }
+    for (int i = 0; i != UN_SNAPSHOT_HASH_COUNT; ++i) {
+        const uint64_t size =
+            sections[UN_SNAPSHOT_HASH + i].bytes / sizeof(Hash_Node);
+        if (!is_power_of_2(size) || size < UN_HASH_LINE_SIZE ||
+            header->hash_counts[i] >= size) {
+            return EINVAL;
+        }
+    }
+    for (int i = 0; i != UN_SNAPSHOT_INVERSE_COUNT; ++i) {
+        const Snapshot_InverseHash *info = header->inverses + i;
+        if (!info->key_capacity || !info->page_capacity ||
+            sections[UN_SNAPSHOT_APP_LRV_PAGES + 2 * i].bytes !=
+                info->page_capacity * sizeof(InverseHash_Page) ||
+            sections[UN_SNAPSHOT_APP_LRV_HEADS + 2 * i].bytes !=
+                info->key_capacity * sizeof(uint32_t)) {
+            return EINVAL;
+        }
+    }
+    if (!header->pending_capacity || !header->pending_ob_capacity ||
+        header->pending_size > header->pending_capacity ||
+        header->carrier_free_list >= header->carrier_free_range ||
+        sections[UN_SNAPSHOT_PENDING_HEAP].bytes !=
+            header->pending_capacity * sizeof(ObQueue_Entry) ||
+        sections[UN_SNAPSHOT_PENDING_POSITIONS].bytes !=
+            header->pending_ob_capacity * sizeof(uint32_t) ||
+        sections[UN_SNAPSHOT_REPS].bytes !=
+            header->reps_capacity * sizeof(Ob)) {
+        return EINVAL;
+    }
+    const Snapshot_AbsEntry *entries =
+        Snapshot_data(base, UN_SNAPSHOT_ABS_INDEX);
+    const uint64_t payload_bytes = sections[UN_SNAPSHOT_ABS_PAYLOAD].bytes;
+    for (uint32_t i = 0; i != header->abs_count; ++i) {
+        if (entries[i].size <= UN_ABS_INLINE) return EINVAL;
+        const uint64_t bytes =
+            AbsList_capacity(entries[i].size) * sizeof(AbsList_Node);
+        if (!entries[i].ob || entries[i].ob >= header->carrier_free_range ||
+            entries[i].offset > payload_bytes ||
+            bytes > payload_bytes - entries[i].offset) {
+            return EINVAL;
+        }
+    }
+    return 0;
+}
+
+// Points a Structure's arrays into a validated, writable mapping.
+static void Structure_init_mapped(Structure *structure, char *base,
+                                  size_t bytes) {
+    bzero(structure, sizeof(Structure));
+    structure->mapping.begin = base;
+    structure->mapping.end = base + bytes;
+    const Mapping *mapping = &structure->mapping;
+    const Snapshot_Header *header = (const Snapshot_Header *)base;
+    const Snapshot_Section *sections = header->sections;
+
+    Carrier *carrier = &structure->carrier;
+    carrier->nodes = Snapshot_data(base, UN_SNAPSHOT_CARRIER);
+    carrier->free_range = header->carrier_free_range;
+    carrier->free_list = header->carrier_free_list;
+    carrier->capacity = header->carrier_capacity;
+    carrier->mapping = mapping;
+    carrier->abs_arena.mapping = mapping;
+    for (Ob ob = carrier->free_list;
+         ob && carrier->free_count < carrier->free_range;
+         ob = carrier->nodes[ob].obs[0]) {
+        ++carrier->free_count;
+    }
+    const Snapshot_AbsEntry *entries =
+        Snapshot_data(base, UN_SNAPSHOT_ABS_INDEX);
+    char *payload = Snapshot_data(base, UN_SNAPSHOT_ABS_PAYLOAD);
+    for (uint32_t i = 0; i != header->abs_count; ++i) {
+        AbsList *abs = &carrier->nodes[entries[i].ob].abs;
+        abs->outline.nodes = (AbsList_Node *)(payload + entries[i].offset);
+        abs->outline.size = entries[i].size;
+        abs->outline.tag = UN_ABS_OUTLINE;
+    }
+
+    Hash *hashes[UN_SNAPSHOT_HASH_COUNT] = {
+        &structure->hash, &structure->app_LRv, &structure->abs_LRv,
+        &structure->ints};
+    InverseHash *inverses[UN_SNAPSHOT_INVERSE_COUNT] = {
+        &structure->app_Lrv, &structure->app_Rlv, &structure->app_Vlr,
+        &structure->abs_Lrv, &structure->abs_Vlr};
+    for (int i = 0; i != UN_SNAPSHOT_HASH_COUNT; ++i) {
+        hashes[i]->nodes = Snapshot_data(base, UN_SNAPSHOT_HASH + i);
+        hashes[i]->size =
+            sections[UN_SNAPSHOT_HASH + i].bytes / sizeof(Hash_Node);
+        hashes[i]->mask = hashes[i]->size - 1UL;
+        hashes[i]->count = header->hash_counts[i];
+        hashes[i]->mapping = mapping;
+    }
+    for (int i = 0; i != UN_SNAPSHOT_INVERSE_COUNT; ++i) {
+
+        const Snapshot_InverseHash *info = header->inverses + i;
+        inverses[i]->pages =
+            Snapshot_data(base, UN_SNAPSHOT_APP_LRV_PAGES + 2 * i);
+        inverses[i]->heads =
+            Snapshot_data(base, UN_SNAPSHOT_APP_LRV_HEADS + 2 * i);
+        inverses[i]->count = info->count;
+        inverses[i]->key_capacity = info->key_capacity;
+        inverses[i]->page_free_range = info->page_free_range;
+        inverses[i]->page_free_list = info->page_free_list;
+        inverses[i]->page_capacity = info->page_capacity;
+        inverses[i]->mapping = mapping;
+    }
+
+    ObQueue *pending = &structure->pending;
+    pending->heap = Snapshot_data(base, UN_SNAPSHOT_PENDING_HEAP);
+    pending->positions = Snapshot_data(base, UN_SNAPSHOT_PENDING_POSITIONS);
+    pending->size = header->pending_size;
+    pending->capacity = header->pending_capacity;
+    pending->ob_capacity = header->pending_ob_capacity;
+    pending->mapping = mapping;
+
+    if (header->reps_capacity) {
+        structure->reps.parents = Snapshot_data(base, UN_SNAPSHOT_REPS);
+        structure->reps.capacity = header->reps_capacity;
+    }
+    structure->reps.mapping = mapping;
+
+    ObStack_init(&structure->merges);
+    ObStack_init(&structure->merge_batch);
+    ObStack_init(&structure->merge_keys);
+    Machine_init(&structure->machine);
+}
+
+// ---------------------------------------------------------------------------
+// Parsing and printing
+//
+// Terms are juxtaposed atoms and parenthesized terms, with application
+// associating to the left, as in "S K (K x0) x1". Variables are written
+// x0, ..., x31, bytes 0x00, ..., 0xff, and ints in decimal, as in
+// "LT 7 (ADD -3 x0)". Parsing uses the arg stack of a Machine above its
+// current size, so it does not allocate in steady state.
+
+static const char *const g_atom_names[UN_VARS_BEGIN] = {
+    NULL, "TOP", "BOT", "I", "K", "B", "C", "S", "J",
+};
+
+static const char *const g_native_names[UN_BYTES_BEGIN - UN_VARS_END] = {
+    "TRUE", "FALSE", "ADD", "SUB", "MUL", "DIV", "MOD", "EQ", "LT",
+};
+
+static inline bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool is_name_char(char c) {
+    return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') ||
+           ('0' <= c && c <= '9') || c == '_';
+}
+
+// Writes the name of a non-app ob, returning its length. Bytes are
+// written in hex as 0x00, ..., 0xff, and ints in decimal.
+static size_t name_atom(const Carrier *carrier, Ob ob, char name[16]) {
+    const char *text = NULL;
+    if (ob < UN_VARS_BEGIN) {
+        UN_DCHECK_TRUE(ob);
+        text = g_atom_names[ob];
+    } else if (UN_VARS_END <= ob && ob < UN_BYTES_BEGIN) {
+        text = g_native_names[ob - UN_VARS_END];
+    }
+    if (text) {
+        const size_t size = strlen(text);
+        memcpy(name, text, size + 1UL);
+        return size;
+    }
+    if (is_var(ob)) {
+        return (size_t)snprintf(name, 16, "x%u", ob - UN_VARS_BEGIN);
+    }
+    if (is_byte(ob)) {
+        return (size_t)snprintf(name, 16, "0x%02x", ob - UN_BYTES_BEGIN);
+    }
+    return (size_t)snprintf(name, 16, "%" PRId32,
+                            Carrier_int_value(carrier, ob));
+}
+
+static inline int hex_digit(char c) {
+    if ('0' <= c && c <= '9') return c - '0';
+    if ('a' <= c && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Returns the constant or variable of a name, or 0 if unknown.
+static Ob parse_name(const char *name, size_t size) {
+    for (Ob ob = 1U; ob != UN_VARS_BEGIN; ++ob) {
+        if (strlen(g_atom_names[ob]) == size &&
+            !memcmp(g_atom_names[ob], name, size)) {
+            return ob;
+        }
+    }
+    for (Ob ob = UN_VARS_END; ob != UN_BYTES_BEGIN; ++ob) {
+        const char *native = g_native_names[ob - UN_VARS_END];
+        if (strlen(native) == size && !memcmp(native, name, size)) return ob;
+    }
+    if (size == 4UL && name[0] == '0' && name[1] == 'x') {
+        const int high = hex_digit(name[2]);
+        const int low = hex_digit(name[3]);
+        if (high < 0 || low < 0) return 0U;
+        return UN_BYTES_BEGIN + (Ob)(16 * high + low);
+    }
+    if (size < 2UL || size > 3UL || name[0] != 'x') return 0U;
+    if (size == 3UL && name[1] == '0') return 0U;  // No leading zeros.
+    Ob index = 0;
+    for (size_t i = 1; i != size; ++i) {
+        if (name[i] < '0' || '9' < name[i]) return 0U;
+        index = 10U * index + (Ob)(name[i] - '0');
+    }
+    return index < UN_VARS_END - UN_VARS_BEGIN ? UN_VARS_BEGIN + index : 0U;
+}
+
+// Parses a decimal int in [-2^31, 2^31), without leading zeros. Returns
+// false if malformed or out of range.
+static bool parse_int(const char *name, size_t size, int32_t *value) {
+    const bool negative = size && name[0] == '-';
+    const size_t begin = negative ? 1UL : 0UL;
+    if (size == begin || size - begin > 10UL) return false;
+    if (name[begin] == '0' && size - begin > 1UL) return false;
+    int64_t magnitude = 0;
+    for (size_t i = begin; i != size; ++i) {
+        if (name[i] < '0' || '9' < name[i]) return false;
+        magnitude = 10 * magnitude + (name[i] - '0');
+    }
+    if (magnitude > (int64_t)INT32_MAX + negative) return false;
+    if (negative && !magnitude) return false;  // No -0.
+    *value = (int32_t)(negative ? -magnitude : magnitude);
+    return true;
+}
+
+// Returns the ob of a name, including ints, or 0 if unknown.
+static Ob parse_token(Structure *structure, const char *name, size_t size) {
+    int32_t value;
+    if (parse_int(name, size, &value)) return make_int(structure, value);
+    return parse_name(name, size);
+}
+
+// Applies the partial term on top of a parse stack, if any, to an ob.
+static inline void parse_apply(Structure *structure, ObStack *stack, Ob ob) {
+    Ob *top = stack->data + stack->size - 1U;
+    *top = *top ? make_app(structure, *top, ob) : ob;
+}
+
+// Parses a whole term. Returns 0 on a syntax error.
+static Ob Structure_parse(Structure *structure, const char *text,
+                          size_t size) {
+    // Each entry is a partial term, or 0 if empty, for each open paren.
+    ObStack *stack = &Structure_machine(structure)->args;
+    const uint32_t base = stack->size;
+    ObStack_push(stack, 0U);
+    Ob result = 0U;
+    size_t pos = 0;
+    while (pos != size) {
+        const char c = text[pos];
+        if (is_space(c)) {
+            ++pos;
+        } else if (c == '(') {
+            ObStack_push(stack, 0U);
+            ++pos;
+        } else if (c == ')') {
+            if (stack->size - base < 2U) goto done;
+            const Ob ob = stack->data[--stack->size];
+            if (!ob) goto done;
+            parse_apply(structure, stack, ob);
+            ++pos;
+        } else if (is_name_char(c) || c == '-') {
+            const size_t begin = pos++;
+            while (pos != size && is_name_char(text[pos])) ++pos;
+            const Ob ob = parse_token(structure, text + begin, pos - begin);
+            if (!ob) goto done;
+            parse_apply(structure, stack, ob);
+        } else {
+            goto done;
+        }
+    }
+    if (stack->size - base == 1U) result = stack->data[base];
+done:
+    stack->size = base;
+    return result;
+}
+
+// Print stack entries are obs, flagged if printed as args, or closing parens.
+// The flag is free since Carrier_alloc keeps obs below 2^31.
+#define UN_PRINT_ARG (0x80000000U)
+#define UN_PRINT_CLOSE (0U)
+
+// Appends text to buf[0, size), truncating and advancing *length as
+// snprintf does.
+static inline void print_text(char *buf, size_t size, size_t *length,
+                              const char *text, size_t text_size) {
+    if (*length + 1UL < size) {
+        const size_t room = size - 1UL - *length;
+        memcpy(buf + *length, text, text_size < room ? text_size : room);
+    }
+    *length += text_size;
+}
+
+// Prints a term as Structure_parse reads it, without recursing. This reads
+// only published Carrier nodes, so it may run concurrently with one writer.
+// Returns the length of the text, writing at most size bytes including a
+// terminating nul, as snprintf does.
+static size_t Carrier_print(const Carrier *carrier, Ob ob, ObStack *stack,
+                            char *buf, size_t size) {
+    size_t length = 0;
+    const uint32_t base = stack->size;
+    ObStack_push(stack, ob);
+    while (stack->size != base) {
+        const Ob item = stack->data[--stack->size];
+        if (item == UN_PRINT_CLOSE) {
+            print_text(buf, size, &length, ")", 1UL);
+            continue;
+        }
+        Ob head = item & ~UN_PRINT_ARG;
+        const Carrier_Node *node = Carrier_node(carrier, head);
+        if (item & UN_PRINT_ARG) {
+            print_text(buf, size, &length, " ", 1UL);
+            if (node->obs[0] && node->obs[1]) {
+                print_text(buf, size, &length, "(", 1UL);
+                ObStack_push(stack, UN_PRINT_CLOSE);
+            }
+        }
+        // Push args last to first, so that they pop first to last.
+        while (node->obs[0] && node->obs[1]) {
+            ObStack_push(stack, node->obs[1] | UN_PRINT_ARG);
+            head = node->obs[0];
+            node = Carrier_node(carrier, head);
+        }
+        char name[16];
+        print_text(buf, size, &length, name, name_atom(carrier, head, name));
+    }
+    if (size) buf[length < size ? length : size - 1UL] = '\0';
+    return length;
+}
+
+// ---------------------------------------------------------------------------
+// Serialization
+//
+// Terms are serialized as DAGs, emitting each distinct subterm once, in
+// topological order. All integers are LEB128 varints. The format is:
+//
+//   "HSTR" version
+//   atom_count (name_size name)*   // Non-apps, by name.
+//   app_count (lhs rhs)*           // Back-references.
+//   root                           // A back-reference from the end.
+//
+// Atoms take indices [0, atom_count) and apps the following indices. The
+// app at index i refers to the term at index j as i - j, so references to
+// nearby subterms take one byte.
+
+#define UN_SERIAL_MAGIC "HSTR"
+#define UN_SERIAL_VERSION 1U
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} Bytes;
+
+static void Bytes_reserve(Bytes *bytes, size_t size) {
+    if (bytes->size + size > bytes->capacity) {
+        while (bytes->size + size > bytes->capacity) {
+            bytes->capacity = bytes->capacity ? 2UL * bytes->capacity : 64UL;
+        }
+        bytes->data = realloc_or_die(bytes->data, bytes->capacity);
+    }
+}
+
+static void Bytes_append(Bytes *bytes, const void *data, size_t size) {
+    Bytes_reserve(bytes, size);
+    memcpy(bytes->data + bytes->size, data, size);
+    bytes->size += size;
+}
+
+static void Bytes_append_varint(Bytes *bytes, uint64_t value) {
+    Bytes_reserve(bytes, 10UL);
+    do {
+        const uint8_t byte = value & 0x7FU;
+        value >>= 7U;
+        bytes->data[bytes->size++] = byte | (value ? 0x80U : 0U);
+    } while (value);
+}
+
+// Reads a varint, advancing *pos. Returns false if truncated or too long.
+static bool read_varint(const uint8_t *data, size_t size, size_t *pos,
+                        uint64_t *value) {
+    *value = 0;
+    for (unsigned int shift = 0; shift < 64U; shift += 7U) {
+        if (*pos == size) return false;
+        const uint8_t byte = data[(*pos)++];
+        *value |= (uint64_t)(byte & 0x7FU) << shift;
+        if (!(byte & 0x80U)) return true;
+    }
+    return false;
+}
+
+// Visit stack entries are obs, flagged once their args are visited.
+#define UN_SERIAL_VISITED (0x80000000U)
+
+// Returns the index of a visited ob, as numbered by Carrier_serialize.
+static inline uint64_t serial_index(const Carrier *carrier, const Hash *index,
+                                    uint32_t atom_count, Ob ob) {
+    const Word key = {.ob_pair = {ob, 0U}};
+    const Hash_Node *found = Hash_find(index, key);
+    UN_DCHECK_TRUE(found);
+    const uint64_t pos = found->slot.val - 1U;
+    return Carrier_is_app(carrier, ob) ? atom_count + pos : pos;
+}
+
+// Serializes a term. Obs are numbered in a Hash keyed by ob, whose values
+// are one more than each ob's position among atoms or apps, so each is
+// visited once however often it is shared.
+static void Carrier_serialize(const Carrier *carrier, Ob root,
+                              ObStack *stack, Bytes *bytes) {
+    Hash index;
+    Hash_init(&index, UN_HASH_LINE_SIZE);
+    ObStack atoms;  // Non-apps, in order of first visit.
+    ObStack_init(&atoms);
+    ObStack order;  // Apps in post-order.
+    ObStack_init(&order);
+    const uint32_t base = stack->size;
+    ObStack_push(stack, root);
+    while (stack->size != base) {
+        const Ob item = stack->data[--stack->size];
+        const Ob ob = item & ~UN_SERIAL_VISITED;
+        const Word key = {.ob_pair = {ob, 0U}};
+        if (Hash_find(&index, key)) continue;
+        const Carrier_Node *node = Carrier_node(carrier, ob);
+        if (!(node->obs[0] && node->obs[1])) {
+            ObStack_push(&atoms, ob);
+            const Hash_Node node_to_insert = {.uint32s = {ob, 0U, atoms.size}};
+            Hash_insert(&index, &node_to_insert);
+            continue;
+        }
+        if (item & UN_SERIAL_VISITED) {
+            ObStack_push(&order, ob);
+            const Hash_Node node_to_insert = {.uint32s = {ob, 0U, order.size}};
+            Hash_insert(&index, &node_to_insert);
+            continue;
+        }
+        ObStack_push(stack, ob | UN_SERIAL_VISITED);
+        ObStack_push(stack, node->obs[1]);
+        ObStack_push(stack, node->obs[0]);
+    }
+
+    Bytes_append(bytes, UN_SERIAL_MAGIC, 4UL);
+    Bytes_append_varint(bytes, UN_SERIAL_VERSION);
+    const uint32_t atom_count = atoms.size;
+    Bytes_append_varint(bytes, atom_count);
+    for (uint32_t i = 0; i != atom_count; ++i) {
+        char name[16];
+        const size_t name_size = name_atom(carrier, atoms.data[i], name);
+        Bytes_append_varint(bytes, name_size);
+        Bytes_append(bytes, name, name_size);
+    }
+    Bytes_append_varint(bytes, order.size);
+    for (uint32_t i = 0; i != order.size; ++i) {
+        const Carrier_Node *node = Carrier_node(carrier, order.data[i]);
+        for (int j = 0; j != 2; ++j) {
+            const uint64_t arg_index =
+                serial_index(carrier, &index, atom_count, node->obs[j]);
+            Bytes_append_varint(bytes, atom_count + i - arg_index);
+        }
+    }
+    const uint64_t root_index = serial_index(carrier, &index, atom_count, root);
+    Bytes_append_varint(bytes, atom_count + order.size - root_index);
+
+    ObStack_delete(&order);
+    ObStack_delete(&atoms);
+    Hash_clear(&index);
+}
+
+// Builds a serialized term, hash-consing each app as it is read. Returns 0
+// if the data is invalid.
+static Ob Structure_deserialize(Structure *structure, const uint8_t *data,
+                                size_t size) {
+    size_t pos = 0;
+    uint64_t version, atom_count, app_count;
+    if (size < 4UL || memcmp(data, UN_SERIAL_MAGIC, 4UL)) return 0U;
+    pos = 4UL;
+    if (!read_varint(data, size, &pos, &version)) return 0U;
+    if (version != UN_SERIAL_VERSION) return 0U;
+    if (!read_varint(data, size, &pos, &atom_count)) return 0U;
+    // Each atom and app takes at least one byte per field, which bounds the
+    // table before it is allocated.
+    if (atom_count > (size - pos) / 2UL) return 0U;
+    Ob result = 0U;
+    ObStack table;
+    ObStack_init(&table);
+    for (uint64_t i = 0; i != atom_count; ++i) {
+        uint64_t name_size;
+        if (!read_varint(data, size, &pos, &name_size)) goto done;
+        if (name_size > size - pos) goto done;
+        const Ob ob =
+            parse_token(structure, (const char *)data + pos, name_size);
+        if (!ob) goto done;
+        pos += name_size;
+        ObStack_push(&table, ob);
+    }
+    if (!read_varint(data, size, &pos, &app_count)) goto done;
+    if (app_count > (size - pos) / 2UL) goto done;
+    for (uint64_t i = 0; i != app_count; ++i) {
+        Ob args[2];
+        for (int j = 0; j != 2; ++j) {
+            uint64_t back;
+            if (!read_varint(data, size, &pos, &back)) goto done;
+            if (!back || back > table.size) goto done;
+            args[j] = table.data[table.size - back];
+        }
+        ObStack_push(&table, make_app(structure, args[0], args[1]));
+    }
+    uint64_t back;
+    if (!read_varint(data, size, &pos, &back)) goto done;
+    if (!back || back > table.size || pos != size) goto done;
+    result = table.data[table.size - back];
+done:
+    ObStack_delete(&table);
+    return result;
+}
+
+// -----------------------------------------------------------------------
+// Interface
+
+struct un_engine {
+    Structure structure;
+    // The following are used only by shared engines.
+    bool shared;
+    Epoch *epoch;
+    pthread_mutex_t mutex;
+    Workers *workers;  // Set iff parallel.
+    void *snapshot;    // Set iff opened from a snapshot.
+    size_t snapshot_bytes;
+};
+
+un_engine_t *un_engine_new(size_t capacity) {
+    un_engine_t *engine = malloc_or_die(sizeof(un_engine_t));
+    Structure_init(&engine->structure, capacity ? capacity : UN_INIT_CAPACITY);
+    engine->shared = false;
+    engine->epoch = NULL;
+    engine->workers = NULL;
+    engine->snapshot = NULL;
+    engine->snapshot_bytes = 0;
+    return engine;
+}
+
+un_engine_t *un_engine_new_shared(size_t capacity) {
+    un_engine_t *engine = un_engine_new(capacity);
+    engine->shared = true;
+    engine->epoch = Epoch_new();
+    engine->structure.hash.epoch = engine->epoch;
+    engine->structure.carrier.epoch = engine->epoch;  // For un_print_ex.
+    UN_CHECK(!pthread_mutex_init(&engine->mutex, NULL), "mutex init failed");
+    return engine;
+}
+
+un_engine_t *un_engine_new_parallel(size_t capacity, size_t num_threads) {
+    un_engine_t *engine = un_engine_new_shared(capacity);
+    if (num_threads < 2UL) return engine;
+    Structure *structure = &engine->structure;
+    structure->app_LRv.epoch = engine->epoch;
+    engine->workers = Workers_new(structure, engine->epoch, num_threads);
+    structure->workers = engine->workers;
+    return engine;
+}
+
+void un_engine_free(un_engine_t *engine) {
+    if (!engine) return;
+    if (engine->workers) Workers_delete(engine->workers);
+    Structure_clear(&engine->structure);
+    if (engine->shared) {
+        Epoch_delete(engine->epoch);
+        pthread_mutex_destroy(&engine->mutex);
+    }
+    if (engine->snapshot) munmap(engine->snapshot, engine->snapshot_bytes);
+    free(engine);
+}
+
+un_engine_t *un_engine_open_snapshot(const char *path) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat stat;
+    if (fstat(fd, &stat)) {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        return NULL;
+    }
+    const size_t bytes = (size_t)stat.st_size;
+    void *base = (bytes >= sizeof(Snapshot_Header))
+                     ? mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                            fd, 0)
+                     : MAP_FAILED;
+    const int error = (base == MAP_FAILED && bytes >= sizeof(Snapshot_Header))
+                          ? errno
+                          : EINVAL;
+    close(fd);
+    if (base == MAP_FAILED) {
+        errno = error;
+        return NULL;
+    }
+    const int invalid = Snapshot_validate(base, bytes);
+    if (invalid) {
+        munmap(base, bytes);
+        errno = invalid;
+        return NULL;
+    }
+
+    un_engine_t *engine = malloc_or_die(sizeof(un_engine_t));
+    Structure_init_mapped(&engine->structure, base, bytes);
+    engine->shared = false;
+    engine->epoch = NULL;
+    engine->workers = NULL;
+    engine->snapshot = base;
+    engine->snapshot_bytes = bytes;
+    return engine;
+}
+
+// Writes a snapshot to temp_path, then renames it to path.
+static int Structure_save_path(const Structure *structure, const char *path,
+                               const char *temp_path) {
+    const int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return errno;
+    int error = Structure_save(structure, fd);
+    if (close(fd) && !error) error = errno;
+    if (!error && rename(temp_path, path)) error = errno;
+    if (error) unlink(temp_path);
+    return error;
+}
+
+static char *temp_path_for(const char *path) {
+    const size_t size = strlen(path);
+    char *temp_path = malloc_or_die(size + 5UL);
+    memcpy(temp_path, path, size);
+    memcpy(temp_path + size, ".tmp", 5UL);
+    return temp_path;
+}
+
+int un_engine_save_snapshot(un_engine_t *engine, const char *path) {
+    char *temp_path = temp_path_for(path);
+    if (engine->shared) pthread_mutex_lock(&engine->mutex);
+    Structure_process_merges(&engine->structure);
+    Structure_finish_grows(&engine->structure);
+    const int error = Structure_save_path(&engine->structure, path, temp_path);
+    if (engine->shared) pthread_mutex_unlock(&engine->mutex);
+    free(temp_path);
+    return error;
+}
+
+pid_t un_engine_checkpoint(un_engine_t *engine, const char *path) {
+    char *temp_path = temp_path_for(path);
+    if (engine->shared) pthread_mutex_lock(&engine->mutex);
+    Structure_process_merges(&engine->structure);
+    Structure_finish_grows(&engine->structure);
+    const pid_t pid = fork();
+    if (pid == 0) {
+        _exit(Structure_save_path(&engine->structure, path, temp_path) ? 1 : 0);
+    }
+    if (engine->shared) pthread_mutex_unlock(&engine->mutex);
+    free(temp_path);
+    return pid;
+}
+
+static inline void un_engine_lock(un_engine_t *engine) {
+    if (engine->shared) pthread_mutex_lock(&engine->mutex);
+    if (engine->workers) Workers_activate(engine->workers);
+}
+
+static inline void un_engine_unlock(un_engine_t *engine) {
+    if (engine->workers) Workers_deactivate(engine->workers);
+    if (engine->shared) pthread_mutex_unlock(&engine->mutex);
+}
+
+Ob un_simplify_ex(un_engine_t *engine, Ob ob) {
+    UN_CHECK(ob, "ob is null");
+    un_engine_lock(engine);
+    const Ob result = simplify(&engine->structure, ob);
+    un_engine_unlock(engine);
+    return result;
+}
+
+Ob un_simplify_app_ex(un_engine_t *engine, Ob lhs, Ob rhs) {
+    UN_CHECK(lhs, "lhs is null");
+    UN_CHECK(rhs, "rhs is null");
+    if (!engine->shared) return simplify_app(&engine->structure, lhs, rhs);
+
+    // Try a lock-free memo lookup. This may return a memoized result that is
+    // equivalent to, but not yet, its rep, since merges leave memo values to
+    // be canonicalized by later lookups.
+    if (Epoch_enter(engine->epoch)) {
+        const Word key = {.ob_pair = {lhs, rhs}};
+        const Ob result = find_memo_shared(&engine->structure, key);
+        Epoch_exit(engine->epoch);
+        if (result) {
+            UN_COUNT(memo_hits, 1U);
+            return result;
+        }
+    }
+    un_engine_lock(engine);
+    const Ob result = simplify_app(&engine->structure, lhs, rhs);
+    un_engine_unlock(engine);
+    return result;
+}
+
+Ob un_app_ex(un_engine_t *engine, Ob lhs, Ob rhs) {
+    UN_CHECK(lhs, "lhs is null");
+    UN_CHECK(rhs, "rhs is null");
+    un_engine_lock(engine);
+    const Ob result = make_app(&engine->structure, lhs, rhs);
+    un_engine_unlock(engine);
+    return result;
+}
+
+void un_app_many_ex(un_engine_t *engine, const Ob *lhs, const Ob *rhs,
+                    Ob *out, size_t count) {
+    UN_CHECK(!count || (lhs && rhs && out), "batch is null");
+    un_engine_lock(engine);
+    make_app_batch(&engine->structure, lhs, rhs, out, count);
+    un_engine_unlock(engine);
+}
+
+Ob un_int_ex(un_engine_t *engine, int32_t value) {
+    un_engine_lock(engine);
+    const Ob result = make_int(&engine->structure, value);
+    un_engine_unlock(engine);
+    return result;
+}
+
+int un_int_value_ex(un_engine_t *engine, Ob ob, int32_t *value) {
+    UN_CHECK(ob, "ob is null");
+    UN_CHECK(value, "value is null");
+    un_engine_lock(engine);
+    const Carrier *carrier = &engine->structure.carrier;
+    UN_CHECK_LT(ob, carrier->free_range, "u");
+    const bool is_int = Carrier_is_int(carrier, ob);
+    if (is_int) *value = Carrier_int_value(carrier, ob);
+    un_engine_unlock(engine);
+    return is_int;
+}
+
+void un_simplify_app_batch_ex(un_engine_t *engine, const Ob *lhs,
+                              const Ob *rhs, Ob *out, size_t count) {
+    UN_CHECK(!count || (lhs && rhs && out), "batch is null");
+    un_engine_lock(engine);
+    simplify_app_batch(&engine->structure, lhs, rhs, out, count);
+    un_engine_unlock(engine);
+}
+
+size_t un_reduce_pending_ex(un_engine_t *engine, size_t max_count) {
+    un_engine_lock(engine);
+    const size_t count = reduce_pending(&engine->structure, max_count);
+    un_engine_unlock(engine);
+    return count;
+}
+
+Ob un_compute_ex(un_engine_t *engine, Ob ob, int *budget) {
+    UN_CHECK(ob, "ob is null");
+    UN_CHECK(budget, "budget is null");
+    un_engine_lock(engine);
+    const Ob result = compute(&engine->structure, ob, budget);
+    un_engine_unlock(engine);
+    return result;
+}
+
+Ob un_compute_app_ex(un_engine_t *engine, Ob lhs, Ob rhs, int *budget) {
+    UN_CHECK(lhs, "lhs is null");
+    UN_CHECK(rhs, "rhs is null");
+    UN_CHECK(budget, "budget is null");
+    un_engine_lock(engine);
+    const Ob result = compute_app(&engine->structure, lhs, rhs, budget);
+    un_engine_unlock(engine);
+    return result;
+}
+
+void un_sample_ex(un_engine_t *engine, Ob ob, size_t n_samples, uint64_t seed,
+                  int budget, Ob *out) {
+    UN_CHECK(ob, "ob is null");
+    UN_CHECK(out || !n_samples, "out is null");
+    UN_CHECK_LE(n_samples, (size_t)UINT32_MAX, "zu");
+    un_engine_lock(engine);
+    Structure *structure = &engine->structure;
+    const Ob term = simplify(structure, ob);  // Shared by every sample.
+    if (engine->workers && t_worker && n_samples > 1UL) {
+        Workers_sample_many(engine->workers, term, seed, budget, out,
+                            n_samples);
+    } else {
+        for (size_t i = 0; i != n_samples; ++i) {
+            out[i] = sample(structure, term, random_draw(seed, i), budget);
+        }
+    }
+    un_engine_unlock(engine);
+}
+
+Ob un_abstract_ex(un_engine_t *engine, Ob var, Ob ob) {
+    UN_CHECK(is_var(var), "expected a variable, got %u", var);
+    UN_CHECK(ob, "ob is null");
+    un_engine_lock(engine);
+    const Ob result = abstract(&engine->structure, var, ob);
+    un_engine_unlock(engine);
+    return result;
+}
+
+void un_stats_snapshot_ex(un_engine_t *engine, un_stats_t *stats) {
+    UN_CHECK(stats, "stats is null");
+    bzero(stats, sizeof(un_stats_t));
+    Counters counters;
+    Counters_sum(&counters);
+    for (Ob ob = 0U; ob != UN_VARS_BEGIN; ++ob) {
+        stats->reductions += counters.reductions[ob];
+    }
+    stats->reductions_by_head.top = counters.reductions[UN_TOP];
+    stats->reductions_by_head.bot = counters.reductions[UN_BOT];
+    stats->reductions_by_head.i = counters.reductions[UN_I];
+    stats->reductions_by_head.k = counters.reductions[UN_K];
+    stats->reductions_by_head.b = counters.reductions[UN_B];
+    stats->reductions_by_head.c = counters.reductions[UN_C];
+    stats->reductions_by_head.s = counters.reductions[UN_S];
+    stats->reductions_by_head.j = counters.reductions[UN_J];
+    stats->reductions_by_head.native = counters.reductions[0];
+    stats->memo_hits = counters.memo_hits;
+    stats->memo_misses = counters.memo_misses;
+    memcpy(stats->find_probes, counters.find_probes,
+           sizeof(stats->find_probes));
+    memcpy(stats->insert_probes, counters.insert_probes,
+           sizeof(stats->insert_probes));
+    stats->hash_grows = counters.hash_grows;
+    stats->hash_grow_ns = counters.hash_grow_ns;
+    stats->memo_evictions = counters.memo_evictions;
+
+    if (engine->shared) pthread_mutex_lock(&engine->mutex);
+    const Structure *structure = &engine->structure;
+    const Carrier *carrier = &structure->carrier;
+    stats->carrier_used = carrier->free_range - 1U - carrier->free_count;
+    stats->carrier_free_list = carrier->free_count;
+    stats->carrier_capacity = carrier->capacity;
+    stats->memo_count = structure->hash.count;
+    stats->memo_capacity = structure->hash.size;
+    stats->app_count = structure->app_LRv.count;
+    stats->app_capacity = structure->app_LRv.size;
+    if (engine->shared) pthread_mutex_unlock(&engine->mutex);
+}
+
+Ob un_parse_ex(un_engine_t *engine, const char *text, size_t size) {
+    UN_CHECK(text || !size, "text is null");
+    un_engine_lock(engine);
+    const Ob ob = Structure_parse(&engine->structure, text, size);
+    un_engine_unlock(engine);
+    return ob;
+}
+
+size_t un_print_ex(un_engine_t *engine, Ob ob, char *buf, size_t size) {
+    UN_CHECK(ob, "ob is null");
+    UN_CHECK(buf || !size, "buf is null");
+    ObStack stack;
+    ObStack_init(&stack);
+    size_t length;
+    // Shared engines print lock-free, like memo lookups.
+    if (engine->shared && Epoch_enter(engine->epoch)) {
+        length = Carrier_print(&engine->structure.carrier, ob, &stack, buf,
+                               size);
+        Epoch_exit(engine->epoch);
+    } else {
+        un_engine_lock(engine);
+        length = Carrier_print(&engine->structure.carrier, ob, &stack, buf,
+                               size);
+        un_engine_unlock(engine);
+    }
+    ObStack_delete(&stack);
+    return length;
+}
+
+void *un_serialize_ex(un_engine_t *engine, Ob ob, size_t *size) {
+    UN_CHECK(ob, "ob is null");
+    UN_CHECK(size, "size is null");
+    Bytes bytes = {NULL, 0, 0};
+    ObStack stack;
+    ObStack_init(&stack);
+    un_engine_lock(engine);
+    Carrier_serialize(&engine->structure.carrier, ob, &stack, &bytes);
+    un_engine_unlock(engine);
+    ObStack_delete(&stack);
+    *size = bytes.size;
+    return bytes.data;
+}
+
+Ob un_deserialize_ex(un_engine_t *engine, const void *data, size_t size) {
+    UN_CHECK(data || !size, "data is null");
+    un_engine_lock(engine);
+    const Ob ob = Structure_deserialize(&engine->structure, data, size);
+    un_engine_unlock(engine);
+    return ob;
+}
+
+struct un_suspension {
+    un_engine_t *engine;
+    Suspension suspension;
+};
+
+Ob un_compute_resumable_ex(un_engine_t *engine, Ob ob, int *budget,
+                           un_suspension_t **suspension) {
+    UN_CHECK(ob, "ob is null");
+    UN_CHECK(budget, "budget is null");
+    UN_CHECK(suspension, "suspension is null");
+    *suspension = NULL;
+    un_engine_lock(engine);
+    Structure *structure = &engine->structure;
+    const Ob lhs = structure->carrier.nodes[ob].obs[0];
+    const Ob rhs = structure->carrier.nodes[ob].obs[1];
+    Ob result = ob;
+    if (lhs && rhs) {
+        Suspension saved;
+        bzero(&saved, sizeof(Suspension));
+        result = compute_app_resumable(structure, lhs, rhs, budget, &saved);
+        if (!result) {
+            *suspension = malloc_or_die(sizeof(un_suspension_t));
+            (*suspension)->engine = engine;
+            (*suspension)->suspension = saved;
+            Suspension_link(&structure->suspensions,
+                            &(*suspension)->suspension);
+        }
+    }
+    un_engine_unlock(engine);
+    return result;
+}
+
+Ob un_compute_resume(un_suspension_t *suspension, int *budget) {
+    UN_CHECK(suspension, "suspension is null");
+    UN_CHECK(budget, "budget is null");
+    un_engine_t *engine = suspension->engine;
+    un_engine_lock(engine);
+    const Ob result = compute_resume(&engine->structure, budget,
+                                     &suspension->suspension);
+    un_engine_unlock(engine);
+    if (result) un_suspension_free(suspension);
+    return result;
+}
+
+void un_suspension_free(un_suspension_t *suspension) {
+    if (!suspension) return;
+    un_engine_t *engine = suspension->engine;
+    un_engine_lock(engine);
+    Suspension_unlink(&engine->structure.suspensions, &suspension->suspension);
+    un_engine_unlock(engine);
+    free(suspension->suspension.frames);
+    free(suspension->suspension.args);
+    free(suspension);
+}
+
+void un_root_ex(un_engine_t *engine, Ob *root) {
+    UN_CHECK(root, "root is null");
+    un_engine_lock(engine);
+    Structure_add_root(&engine->structure, root);
+    un_engine_unlock(engine);
+}
+
+void un_unroot_ex(un_engine_t *engine, Ob *root) {
+    un_engine_lock(engine);
+    Structure_remove_root(&engine->structure, root);
+    un_engine_unlock(engine);
+}
+
+size_t un_gc_ex(un_engine_t *engine, int compact) {
+    un_engine_lock(engine);
+    const size_t freed = Structure_gc(&engine->structure, compact != 0);
+    un_engine_unlock(engine);
+    return freed;
+}
+
+void un_set_memo_limit_ex(un_engine_t *engine, size_t max_bytes) {
+    size_t max_size = 0;
+    if (max_bytes) {
+        max_size = UN_HASH_LINE_SIZE;
+        while (2UL * max_size * sizeof(Hash_Node) <= max_bytes) {
+            max_size *= 2UL;
+        }
+    }
+    un_engine_lock(engine);
+    Hash *memo = &engine->structure.hash;
+    UN_ATOMIC_STORE(&memo->max_size, max_size, RELAXED);
+    if (max_size && memo->size > max_size) Hash_shrink(memo, max_size);
+    un_engine_unlock(engine);
+}
+
+// The default engine, used by the un_* functions without an engine argument.
+static un_engine_t g_engine;
+static pthread_once_t g_engine_once = PTHREAD_ONCE_INIT;
+
+static void init_default_engine(void) {
+    Structure_init(&g_engine.structure, UN_INIT_CAPACITY);
+    g_engine.shared = false;
+    g_engine.epoch = NULL;
+    g_engine.workers = NULL;
+    g_engine.snapshot = NULL;
+    g_engine.snapshot_bytes = 0;
+}
+
+void un_init(void) { pthread_once(&g_engine_once, init_default_engine); }
+
+Ob un_simplify(Ob ob) { return un_simplify_ex(&g_engine, ob); }
+
+Ob un_simplify_app(Ob lhs, Ob rhs) {
+    return un_simplify_app_ex(&g_engine, lhs, rhs);
+}
+
+void un_simplify_app_batch(const Ob *lhs, const Ob *rhs, Ob *out,
+                           size_t count) {
+    un_simplify_app_batch_ex(&g_engine, lhs, rhs, out, count);
+}
+
+Ob un_app(Ob lhs, Ob rhs) { return un_app_ex(&g_engine, lhs, rhs); }
+
+void un_app_many(const Ob *lhs, const Ob *rhs, Ob *out, size_t count) {
+    un_app_many_ex(&g_engine, lhs, rhs, out, count);
+}
+
+Ob un_int(int32_t value) { return un_int_ex(&g_engine, value); }
+
+int un_int_value(Ob ob, int32_t *value) {
+    return un_int_value_ex(&g_engine, ob, value);
+}
+
+size_t un_reduce_pending(size_t max_count) {
+    return un_reduce_pending_ex(&g_engine, max_count);
+}
+
+Ob un_compute(Ob ob, int *budget) {
+    return un_compute_ex(&g_engine, ob, budget);
+}
+
+Ob un_compute_app(Ob lhs, Ob rhs, int *budget) {
+    return un_compute_app_ex(&g_engine, lhs, rhs, budget);
+}
+
+Ob un_compute_resumable(Ob ob, int *budget, un_suspension_t **suspension) {
+    return un_compute_resumable_ex(&g_engine, ob, budget, suspension);
+}
+
+void un_sample(Ob ob, size_t n_samples, uint64_t seed, int budget, Ob *out) {
+    un_sample_ex(&g_engine, ob, n_samples, seed, budget, out);
+}
+
+Ob un_abstract(Ob var, Ob ob) { return un_abstract_ex(&g_engine, var, ob); }
+
+void un_root(Ob *root) { un_root_ex(&g_engine, root); }
+void un_unroot(Ob *root) { un_unroot_ex(&g_engine, root); }
+size_t un_gc(int compact) { return un_gc_ex(&g_engine, compact); }
+
+void un_set_memo_limit(size_t max_bytes) {
+    un_set_memo_limit_ex(&g_engine, max_bytes);
+}
+
+Ob un_parse(const char *text, size_t size) {
+    return un_parse_ex(&g_engine, text, size);
+}
+
+size_t un_print(Ob ob, char *buf, size_t size) {
+    return un_print_ex(&g_engine, ob, buf, size);
+}
+
+void *un_serialize(Ob ob, size_t *size) {
+    return un_serialize_ex(&g_engine, ob, size);
+}
+
+Ob un_deserialize(const void *data, size_t size) {
+    return un_deserialize_ex(&g_engine, data, size);
+}
+
+void un_stats_snapshot(un_stats_t *stats) {
+    un_stats_snapshot_ex(&g_engine, stats);
+}
+
+static void Structure_test(unsigned int seed) {
+    UN_UNUSED(seed);
+    Structure structure_;
+    Structure *structure = &structure_;
+    Structure_init(structure, 1UL);
+
+    const Ob app = make_app(structure, UN_K, UN_I);
+    UN_CHECK_EQ(make_app(structure, UN_K, UN_I), app, "u");
+    UN_CHECK_NE(make_app(structure, UN_I, UN_K), app, "u");
+    UN_CHECK_EQ(structure->carrier.nodes[app].obs[0], UN_K, "u");
+    UN_CHECK_EQ(structure->carrier.nodes[app].obs[1], UN_I, "u");
+
+    bool found = false;
+    InverseHash_Iter iter;
+    InverseHash_Iter_init(&iter, &structure->app_Lrv, UN_K);
+    for (const ObPair *pair; (pair = InverseHash_Iter_next(&iter));) {
+        found = found || (pair->lhs == UN_I && pair->rhs == app);
+    }
+    UN_CHECK(found, "missing app_Lrv entry");
+
+    // Check linear reduction rules.
+    const Ob x = UN_VARS_BEGIN;
+    const Ob y = UN_VARS_BEGIN + 1U;
+    const Ob z = UN_VARS_BEGIN + 2U;
+    const Ob yz = make_app(structure, y, z);
+    const Ob xy = make_app(structure, x, y);
+    const Ob xz = make_app(structure, x, z);
+    const Ob kx = make_app(structure, UN_K, x);
+    const Ob ky = make_app(structure, UN_K, y);
+    const Ob bxy = make_app(structure, make_app(structure, UN_B, x), y);
+    const Ob cxy = make_app(structure, make_app(structure, UN_C, x), y);
+    const Ob sxy = make_app(structure, make_app(structure, UN_S, x), y);
+    const Ob botx = make_app(structure, UN_BOT, x);
+    UN_CHECK_EQ(simplify_app(structure, UN_I, x), x, "u");
+    UN_CHECK_EQ(simplify_app(structure, kx, y), x, "u");
+    UN_CHECK_EQ(simplify_app(structure, bxy, z), make_app(structure, x, yz),
+                "u");
+    UN_CHECK_EQ(simplify_app(structure, cxy, z), make_app(structure, xz, y),
+                "u");
+    UN_CHECK_EQ(simplify_app(structure, UN_TOP, x), UN_TOP, "u");
+    UN_CHECK_EQ(simplify_app(structure, botx, y), UN_BOT, "u");
+    UN_CHECK_EQ(simplify_app(structure, x, make_app(structure, ky, z)), xy,
+                "u");
+    UN_CHECK_EQ(simplify_app(structure, sxy, z), make_app(structure, sxy, z),
+                "u");
+
+    // Check that pending apps are drained, most referenced first.
+    const Ob ix = make_app(structure, UN_I, x);
+    const Ob iy = make_app(structure, UN_I, y);
+    make_app(structure, iy, iy);
+    UN_CHECK_LT(ObQueue_priority(&structure->pending, ix),
+                ObQueue_priority(&structure->pending, iy), "u");
+    while (ObQueue_contains(&structure->pending, ix)) {
+        reduce_pending(structure, 1UL);
+    }
+    UN_CHECK_TRUE(!ObQueue_contains(&structure->pending, iy));
+    reduce_pending(structure, SIZE_MAX);
+    UN_CHECK_EQ(structure->pending.size, 0U, "u");
+    UN_CHECK_EQ(simplify(structure, ix), x, "u");
+
+    Structure_validate(structure);
+    Structure_clear(structure);
+}
+
+static void Structure_merge_test(unsigned int seed) {
+    UN_UNUSED(seed);
+    Structure structure_;
+    Structure *structure = &structure_;
+    Structure_init(structure, 1UL);
+    UnionFind *reps = &structure->reps;
+
+    const Ob p = make_app(structure, UN_K, UN_VARS_BEGIN);
+    const Ob q = make_app(structure, UN_K, UN_VARS_BEGIN + 1U);
+    const Ob pp = make_app(structure, p, p);
+    const Ob qq = make_app(structure, q, q);
+    const Ob ppp = make_app(structure, pp, p);
+    const Ob qqq = make_app(structure, qq, q);
+    const Ob pq = make_app(structure, p, q);
+    UN_CHECK_NE(pp, qq, "u");
+    UN_CHECK_NE(ppp, qqq, "u");
+    Hash_Node memo = {.uint32s = {pp, q, ppp}};
+    Hash_insert(&structure->hash, &memo);
+    // Abstractions whose body and whose value will be merged.
+    Structure_insert_abs(structure, UN_VARS_BEGIN + 2U, qq, pq);
+    Structure_insert_abs(structure, UN_VARS_BEGIN + 3U, pp, qqq);
+
+    Structure_ensure_equal(structure, q, p);
+    Structure_process_merges(structure);
+    UN_CHECK_EQ(UnionFind_find(reps, q), p, "u");
+    UN_CHECK_EQ(UnionFind_find(reps, qq), UnionFind_find(reps, pp), "u");
+    UN_CHECK_EQ(UnionFind_find(reps, pq), UnionFind_find(reps, pp), "u");
+    UN_CHECK_EQ(UnionFind_find(reps, qqq), UnionFind_find(reps, ppp), "u");
+    UN_CHECK_EQ(make_app(structure, q, q), UnionFind_find(reps, pp), "u");
+    const Word abs_key = {.ob_pair = {UN_VARS_BEGIN + 2U, pp}};
+    const Hash_Node *abs = Hash_find(&structure->abs_LRv, abs_key);
+    UN_CHECK_TRUE(abs);
+    UN_CHECK_EQ(abs->slot.val, UnionFind_find(reps, pp), "u");
+    const AbsList *pp_abs = &structure->carrier.nodes[pp].abs;
+    UN_CHECK_EQ(AbsList_find(pp_abs, UN_VARS_BEGIN + 2U),
+                UnionFind_find(reps, pp), "u");
+    UN_CHECK_EQ(AbsList_find(pp_abs, UN_VARS_BEGIN + 3U),
+                UnionFind_find(reps, ppp), "u");
+
+    // The memo entry keeps its stale key until the memo is rewritten.
+    UN_CHECK_EQ(find_simplified(structure, pp, q), UnionFind_find(reps, ppp),
+                "u");
+    UN_CHECK_EQ(find_simplified(structure, pp, p), 0U, "u");
+    Structure_rewrite_memo(structure);
+    Structure_process_merges(structure);
+    UN_CHECK_EQ(find_simplified(structure, pp, q), 0U, "u");
+    UN_CHECK_EQ(simplify_app(structure, qq, p), UnionFind_find(reps, ppp),
+                "u");
+
+    // Every app entry should be canonical and indexed.
+    Hash_finish_grow(&structure->app_LRv);
+    const Hash *app_LRv = &structure->app_LRv;
+    for (size_t i = 0; i != app_LRv->size; ++i) {
+        const Hash_Node *node = app_LRv->nodes + i;
+        if (!node->key.uint64s[0]) continue;
+        UN_CHECK_TRUE(UnionFind_is_rep(reps, node->key.ob_pair.lhs));
+        UN_CHECK_TRUE(UnionFind_is_rep(reps, node->key.ob_pair.rhs));
+        UN_CHECK_TRUE(UnionFind_is_rep(reps, node->slot.val));
+    }
+    Structure_validate(structure);
+    Structure_clear(structure);
+}
+
+// Normal forms K^depth x, for each depth and var x, in a shared engine.
+#define UN_SHARED_TEST_DEPTH 8U
+#define UN_SHARED_TEST_THREADS 4U
+#define UN_SHARED_TEST_VARS (UN_VARS_END - UN_VARS_BEGIN)
+#define UN_SHARED_TEST_POOL_SIZE (UN_SHARED_TEST_DEPTH * UN_SHARED_TEST_VARS)
+
+typedef struct {
+    un_engine_t *engine;
+    const Ob *pool;
+    unsigned int seed;
+} SharedTest_Task;
+
+static void *SharedTest_run(void *arg) {
+    SharedTest_Task *task = arg;
+    for (size_t step = 0; step != 20000UL; ++step) {
+        const Ob x = task->pool[rand_r(&task->seed) % UN_SHARED_TEST_POOL_SIZE];
+        const Ob y = task->pool[rand_r(&task->seed) % UN_SHARED_TEST_POOL_SIZE];
+        const Ob kx = un_simplify_app_ex(task->engine, UN_K, x);
+        UN_CHECK_EQ(un_simplify_app_ex(task->engine, kx, y), x, "u");
+    }
+    return NULL;
+}
+
+// Runs SharedTest_run on many threads, while the caller does other work.
+static void SharedTest_start(un_engine_t *engine, const Ob *pool,
+                             unsigned int seed, pthread_t *threads,
+                             SharedTest_Task *tasks) {
+    for (unsigned int i = 0; i != UN_SHARED_TEST_THREADS; ++i) {
+        tasks[i].engine = engine;
+        tasks[i].pool = pool;
+        tasks[i].seed = seed + i;
+        UN_CHECK(!pthread_create(threads + i, NULL, SharedTest_run, tasks + i),
+                 "pthread_create failed");
+    }
+}
+
+static void SharedTest_join(pthread_t *threads) {
+    for (unsigned int i = 0; i != UN_SHARED_TEST_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+static void un_engine_shared_test(unsigned int seed) {
+    un_engine_t *engine = un_engine_new_shared(1UL);
+    Ob pool[UN_SHARED_TEST_POOL_SIZE];
+    for (Ob i = 0; i != UN_SHARED_TEST_VARS; ++i) pool[i] = UN_VARS_BEGIN + i;
+    for (Ob i = UN_SHARED_TEST_VARS; i != UN_SHARED_TEST_POOL_SIZE; ++i) {
+        const Ob x = pool[i - UN_SHARED_TEST_VARS];
+        pool[i] = make_app(&engine->structure, UN_K, x);
+    }
+
+    // Race lock-free hits against misses that grow the memo.
+    pthread_t threads[UN_SHARED_TEST_THREADS];
+    SharedTest_Task tasks[UN_SHARED_TEST_THREADS];
+    SharedTest_start(engine, pool, seed, threads, tasks);
+    SharedTest_join(threads);
+    if (DEBUG) Structure_validate(&engine->structure);
+
+    // Race them against evictions, and against shrinking a grown memo.
+    SharedTest_start(engine, pool, seed, threads, tasks);
+    const struct timespec pause = {.tv_sec = 0, .tv_nsec = 1000000L};
+    for (int round = 0; round != 40; ++round) {
+        un_set_memo_limit_ex(engine, round % 2 ? 0UL : 4096UL);
+        nanosleep(&pause, NULL);
+    }
+    un_set_memo_limit_ex(engine, 4096UL);
+    SharedTest_join(threads);
+    const Hash *memo = &engine->structure.hash;
+    UN_CHECK_LE(memo->size * sizeof(Hash_Node), 4096UL, "zu");
+    if (DEBUG) Structure_validate(&engine->structure);
+    un_engine_free(engine);
+}
+
+// Returns a random term of roughly the given number of apps, built from
+// linear atoms and variables.
+static Ob random_linear_term(Structure *structure, size_t size) {
+    if (!size) {
+        static const Ob atoms[] = {UN_I, UN_K, UN_B, UN_C};
+        const Ob var_count = UN_VARS_END - UN_VARS_BEGIN;
+        const Ob choice = (Ob)rand() % (4U + var_count);
+        return choice < 4U ? atoms[choice] : UN_VARS_BEGIN + choice - 4U;
+    }
+    const size_t lhs_size = (size_t)rand() % size;
+    const Ob lhs = random_linear_term(structure, lhs_size);
+    const Ob rhs = random_linear_term(structure, size - 1UL - lhs_size);
+    return make_app(structure, lhs, rhs);
+}
+
+// Builds the same random term in two engines, for tests that compare them.
+static void random_twin_terms(un_engine_t *engine, Ob *term, un_engine_t *twin,
+                              Ob *twin_term, unsigned int seed, size_t size) {
+    srand(seed);
+    *term = random_linear_term(&engine->structure, size);
+    srand(seed);
+    *twin_term = random_linear_term(&twin->structure, size);
+}
+
+static bool Structure_terms_equal(const Structure *lhs_structure, Ob lhs,
+                                  const Structure *rhs_structure, Ob rhs) {
+    const Carrier_Node *lhs_node = lhs_structure->carrier.nodes + lhs;
+    const Carrier_Node *rhs_node = rhs_structure->carrier.nodes + rhs;
+    if (!(lhs_node->obs[0] && lhs_node->obs[1])) return lhs == rhs;
+    if (!(rhs_node->obs[0] && rhs_node->obs[1])) return false;
+    return Structure_terms_equal(lhs_structure, lhs_node->obs[0], rhs_structure,
+                                 rhs_node->obs[0]) &&
+           Structure_terms_equal(lhs_structure, lhs_node->obs[1], rhs_structure,
+                                 rhs_node->obs[1]);
+}
+
+// Checks that parallel simplification agrees with serial simplification.
+static void un_engine_parallel_test(unsigned int seed) {
+    un_engine_t *serial = un_engine_new(1UL);
+    un_engine_t *parallel = un_engine_new_parallel(1UL, 4UL);
+    for (size_t step = 0; step != 20UL; ++step) {
+        // Shrinking waits for readers other than the driver, which is one.
+        if (step == 10UL) un_set_memo_limit_ex(parallel, 4096UL);
+        // Build x t1 ... t4 with large random ti, identically in both.
+        Ob serial_term = UN_VARS_BEGIN;
+        Ob parallel_term = UN_VARS_BEGIN;
+        for (unsigned int i = 0; i != 4U; ++i) {
+            Ob serial_arg, parallel_arg;
+            random_twin_terms(serial, &serial_arg, parallel, &parallel_arg,
+                              seed + 4U * (unsigned int)step + i,
+                              4UL * UN_PARALLEL_CUTOFF);
+            serial_term = make_app(&serial->structure, serial_term, serial_arg);
+            parallel_term =
+                make_app(&parallel->structure, parallel_term, parallel_arg);
+        }
+        const Ob serial_result = un_simplify_ex(serial, serial_term);
+        const Ob parallel_result = un_simplify_ex(parallel, parallel_term);
+        UN_CHECK(Structure_terms_equal(&serial->structure, serial_result,
+                                       &parallel->structure, parallel_result),
+                 "parallel simplification disagrees at step %zu", step);
+    }
+    if (DEBUG) Structure_validate(&parallel->structure);
+    un_engine_free(parallel);
+    un_engine_free(serial);
+}
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    Epoch *epoch;
+    uint32_t holding;  // Threads that took a slot.
+    uint32_t refused;  // Threads that found none.
+    bool release;
+} SlotTest;
+
+// Holds an Epoch slot, if one is free, until released.
+static void *SlotTest_hold(void *arg) {
+    SlotTest *test = arg;
+    const bool entered = Epoch_enter(test->epoch);
+    pthread_mutex_lock(&test->lock);
+    if (entered) {
+        ++test->holding;
+    } else {
+        ++test->refused;
+    }
+    pthread_cond_broadcast(&test->cond);
+    while (entered && !test->release) {
+        pthread_cond_wait(&test->cond, &test->lock);
+    }
+    pthread_mutex_unlock(&test->lock);
+    if (entered) Epoch_exit(test->epoch);
+    return NULL;
+}
+
+static void *SlotTest_run_parallel(void *arg) {
+    un_engine_parallel_test(*(const unsigned int *)arg);
+    return NULL;
+}
+
+// Checks that a parallel engine runs serially when no Epoch slot is free.
+static void un_engine_no_slot_test(unsigned int seed) {
+    SlotTest test;
+    bzero(&test, sizeof(test));
+    UN_CHECK(!pthread_mutex_init(&test.lock, NULL), "mutex init failed");
+    UN_CHECK(!pthread_cond_init(&test.cond, NULL), "cond init failed");
+    test.epoch = Epoch_new();
+    pthread_t holders[UN_EPOCH_SLOTS + 1U];
+    uint32_t count = 0;
+    for (bool full = false; !full;) {
+        UN_CHECK_LT(count, UN_EPOCH_SLOTS + 1U, "u");
+        UN_CHECK(!pthread_create(holders + count, NULL, SlotTest_hold, &test),
+                 "pthread_create failed");
+        ++count;
+        pthread_mutex_lock(&test.lock);
+        while (test.holding + test.refused != count) {
+            pthread_cond_wait(&test.cond, &test.lock);
+        }
+        full = test.refused;
+        pthread_mutex_unlock(&test.lock);
+    }
+    pthread_t driver;
+    UN_CHECK(!pthread_create(&driver, NULL, SlotTest_run_parallel, &seed),
+             "pthread_create failed");
+    pthread_join(driver, NULL);
+    pthread_mutex_lock(&test.lock);
+    test.release = true;
+    pthread_cond_broadcast(&test.cond);
+    pthread_mutex_unlock(&test.lock);
+    for (uint32_t i = 0; i != count; ++i) pthread_join(holders[i], NULL);
+    Epoch_delete(test.epoch);
+    pthread_cond_destroy(&test.cond);
+    pthread_mutex_destroy(&test.lock);
+}
+
+// Applies the same random work to each engine, checking that results agree.
+static void un_engine_snapshot_test_step(un_engine_t *lhs, un_engine_t *rhs,
+                                         unsigned int seed) {
+    for (size_t step = 0; step != 20UL; ++step) {
+        Ob lhs_term, rhs_term;
+        random_twin_terms(lhs, &lhs_term, rhs, &rhs_term,
+                          seed + (unsigned int)step, 20UL);
+        UN_CHECK_EQ(lhs_term, rhs_term, "u");
+        UN_CHECK_EQ(un_simplify_ex(lhs, lhs_term),
+                    un_simplify_ex(rhs, rhs_term), "u");
+    }
+    UN_CHECK_EQ(un_reduce_pending_ex(lhs, 100UL),
+                un_reduce_pending_ex(rhs, 100UL), "zu");
+}
+
+static void un_engine_snapshot_test(unsigned int seed) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/hstar_snapshot_test_%d", (int)getpid());
+    un_engine_t *engine = un_engine_new(1UL);
+    un_engine_t *twin = un_engine_new(1UL);
+    un_engine_snapshot_test_step(engine, twin, seed);
+
+    UN_CHECK_EQ(un_engine_save_snapshot(engine, path), 0, "d");
+    un_engine_t *opened = un_engine_open_snapshot(path);
+    UN_CHECK(opened, "failed to open snapshot: %s", strerror(errno));
+    if (DEBUG) Structure_validate(&opened->structure);
+    UN_CHECK_EQ(opened->structure.carrier.free_range,
+                engine->structure.carrier.free_range, "u");
+
+    // Check that opened engines grow out of their mapping.
+    for (unsigned int i = 1; i <= 10U; ++i) {
+        un_engine_snapshot_test_step(engine, opened, seed + 100U * i);
+    }
+    if (DEBUG) Structure_validate(&opened->structure);
+    un_engine_free(opened);
+
+    const pid_t pid = un_engine_checkpoint(engine, path);
+    UN_CHECK_LT(0, pid, "d");
+    int status;
+    UN_CHECK_EQ(waitpid(pid, &status, 0), pid, "d");
+    UN_CHECK(WIFEXITED(status) && !WEXITSTATUS(status), "checkpoint failed");
+    opened = un_engine_open_snapshot(path);
+    UN_CHECK(opened, "failed to open checkpoint: %s", strerror(errno));
+    un_engine_snapshot_test_step(engine, opened, seed + 2000U);
+    un_engine_free(opened);
+
+    // Check that many snapshots may be open at once.
+    enum { open_count = 100 };
+    un_engine_t *many[open_count];
+    for (int i = 0; i != open_count; ++i) {
+        many[i] = un_engine_open_snapshot(path);
+        UN_CHECK(many[i], "failed to open snapshot %d: %s", i, strerror(errno));
+    }
+    un_engine_snapshot_test_step(many[0], many[open_count - 1], seed + 3000U);
+    for (int i = 0; i != open_count; ++i) un_engine_free(many[i]);
+
+    // Check that truncated snapshots are rejected.
+    const int fd = open(path, O_WRONLY);
+    UN_CHECK_LE(0, fd, "d");
+    UN_CHECK_EQ(ftruncate(fd, 100), 0, "d");
+    close(fd);
+    UN_CHECK(!un_engine_open_snapshot(path), "opened a truncated snapshot");
+    UN_CHECK_EQ(errno, EINVAL, "d");
+
+    unlink(path);
+    un_engine_free(twin);
+    un_engine_free(engine);
+}
+
+// Checks that budgeted computation can be suspended and resumed, including
+// across garbage collection.
+static void un_engine_compute_test(unsigned int seed) {
+    UN_UNUSED(seed);
+    enum { depth = 100 };
+    un_engine_t *engine = un_engine_new(1UL);
+    Structure *structure = &engine->structure;
+    const Ob x = UN_VARS_BEGIN;
+    const Ob y = UN_VARS_BEGIN + 1U;
+    const Ob ki = make_app(structure, UN_K, UN_I);
+    const Ob skii = make_app(structure, make_app(structure, UN_S, ki), UN_I);
+
+    // S (K I) I (S (K I) I (... (x y))) takes one S step per level.
+    Ob term = make_app(structure, x, y);
+    for (size_t i = 0; i != depth; ++i) term = make_app(structure, skii, term);
+    int budget = 0;
+    UN_CHECK_EQ(un_compute_ex(engine, term, &budget), term, "u");
+    budget = depth + 10;
+    Ob result = un_compute_ex(engine, term, &budget);
+    UN_CHECK_EQ(budget, 10, "d");
+    UN_CHECK_EQ(structure->carrier.nodes[result].obs[0], x, "u");
+    UN_CHECK_EQ(structure->carrier.nodes[result].obs[1], y, "u");
+    budget = depth / 2;
+    result = un_compute_ex(engine, term, &budget);
+    UN_CHECK_EQ(budget, 0, "d");
+    UN_CHECK_EQ(structure->carrier.nodes[result].obs[0], skii, "u");
+
+    // Resume one step at a time, collecting garbage midway.
+    un_root_ex(engine, &term);
+    un_suspension_t *suspension;
+    budget = 1;
+    UN_CHECK_EQ(un_compute_resumable_ex(engine, term, &budget, &suspension),
+                0U, "u");
+    UN_CHECK(suspension, "expected a suspension");
+    size_t resumes = 0;
+    do {
+        if (resumes == depth / 2) un_gc_ex(engine, 1);
+        budget = 1;
+        ++resumes;
+    } while (!(result = un_compute_resume(suspension, &budget)));
+    UN_CHECK_EQ(resumes + 1UL, (size_t)depth, "zu");
+    UN_CHECK_EQ(structure->carrier.nodes[result].obs[0], x, "u");
+    UN_CHECK_EQ(structure->carrier.nodes[result].obs[1], y, "u");
+    UN_CHECK_EQ(structure->machine.frame_count, 0U, "u");
+    un_unroot_ex(engine, &term);
+
+    // Nonterminating computations can be abandoned.
+    const Ob sii = make_app(structure, make_app(structure, UN_S, UN_I), UN_I);
+    const Ob omega = make_app(structure, sii, sii);
+    budget = 100;
+    UN_CHECK_EQ(un_compute_resumable_ex(engine, omega, &budget, &suspension),
+                0U, "u");
+    budget = 100;
+    UN_CHECK_EQ(un_compute_resume(suspension, &budget), 0U, "u");
+    un_suspension_free(suspension);
+    UN_CHECK(!structure->suspensions, "suspension was not unlinked");
+    budget = 100;
+    UN_CHECK(un_compute_ex(engine, omega, &budget), "compute failed");
+    UN_CHECK_EQ(budget, 0, "d");
+    if (DEBUG) Structure_validate(structure);
+    un_engine_free(engine);
+}
+
+// Checks that batches agree with apps simplified one at a time.
+static void un_engine_batch_test(unsigned int seed) {
+    enum { count = 3 * UN_BATCH_SIZE + 5 };
+    un_engine_t *engine = un_engine_new(1UL);
+    un_engine_t *twin = un_engine_new(1UL);
+    Ob lhs[count], rhs[count], out[count];
+    Ob twin_lhs[count], twin_rhs[count];
+    for (size_t i = 0; i != count; ++i) {
+        // Repeat some apps, so that batches contain both hits and misses.
+        const unsigned int term = (unsigned int)(i % (count / 2));
+        random_twin_terms(engine, lhs + i, twin, twin_lhs + i,
+                          seed + 2U * term, 5UL);
+        random_twin_terms(engine, rhs + i, twin, twin_rhs + i,
+                          seed + 2U * term + 1U, 5UL);
+    }
+    un_simplify_app_batch_ex(engine, lhs, rhs, out, count);
+    for (size_t i = 0; i != count; ++i) {
+        const Ob expected = un_simplify_app_ex(twin, twin_lhs[i], twin_rhs[i]);
+        UN_CHECK(Structure_terms_equal(&engine->structure, out[i],
+                                       &twin->structure, expected),
+                 "batch disagrees at %zu", i);
+        UN_CHECK_EQ(un_simplify_app_ex(engine, lhs[i], rhs[i]), out[i], "u");
+    }
+    un_simplify_app_batch_ex(engine, lhs, rhs, out, 0UL);
+    un_engine_free(twin);
+    un_engine_free(engine);
+}
+
+static Ob un_parse_string(un_engine_t *engine, const char *text) {
+    return un_parse_ex(engine, text, strlen(text));
+}
+
+static void un_engine_parse_test(unsigned int seed) {
+    UN_UNUSED(seed);
+    un_engine_t *engine = un_engine_new(1UL);
+    const Ob x = UN_VARS_BEGIN, y = UN_VARS_BEGIN + 1U;
+    UN_CHECK_EQ(un_parse_string(engine, "K"), UN_K, "u");
+    UN_CHECK_EQ(un_parse_string(engine, " x31\n"), UN_VARS_END - 1U, "u");
+    const Ob xy = make_app(&engine->structure, x, y);
+    UN_CHECK_EQ(un_parse_string(engine, "x0 x1"), xy, "u");
+    UN_CHECK_EQ(un_parse_string(engine, "((x0) (x1))"), xy, "u");
+    const Ob xyx = make_app(&engine->structure, xy, x);
+    UN_CHECK_EQ(un_parse_string(engine, "x0 x1 x0"), xyx, "u");
+    UN_CHECK_EQ(un_parse_string(engine, "x0 (x1 x0)"),
+                make_app(&engine->structure, x,
+                         make_app(&engine->structure, y, x)),
+                "u");
+    static const char *const invalid[] = {
+        "", " ", "(", ")", "()", "x0)", "(x0", "x32", "x01", "x", "k", "S+K",
+    };
+    for (size_t i = 0; i != sizeof(invalid) / sizeof(invalid[0]); ++i) {
+        UN_CHECK_EQ(un_parse_string(engine, invalid[i]), 0U, "u");
+    }
+    UN_CHECK_EQ(Structure_machine(&engine->structure)->args.size, 0U, "u");
+
+    static const char *const texts[] = {
+        "TOP", "x31", "x0 x1", "S K (K x0) x1", "x0 (x1 (x2 x3) x4) (B C)",
+    };
+    char buf[64];
+    for (size_t i = 0; i != sizeof(texts) / sizeof(texts[0]); ++i) {
+        const Ob ob = un_parse_string(engine, texts[i]);
+        const size_t length = un_print_ex(engine, ob, buf, sizeof(buf));
+        UN_CHECK_EQ(length, strlen(texts[i]), "zu");
+        UN_CHECK(!strcmp(buf, texts[i]), "printed %s as %s", texts[i], buf);
+    }
+    UN_CHECK_EQ(un_print_ex(engine, xyx, buf, 4UL), 8UL, "zu");
+    UN_CHECK(!strcmp(buf, "x0 "), "truncated to %s", buf);
+    UN_CHECK_EQ(un_print_ex(engine, xyx, NULL, 0UL), 8UL, "zu");
+
+    // Deep terms print without recursing.
+    Ob deep = x;
+    for (size_t i = 0; i != 100000UL; ++i) {
+        deep = make_app(&engine->structure, y, deep);
+    }
+    const size_t deep_length = un_print_ex(engine, deep, NULL, 0UL);
+    char *deep_text = malloc_or_die(deep_length + 1UL);
+    UN_CHECK_EQ(un_print_ex(engine, deep, deep_text, deep_length + 1UL),
+                deep_length, "zu");
+    UN_CHECK_EQ(un_parse_ex(engine, deep_text, deep_length), deep, "u");
+    free(deep_text);
+
+    un_engine_free(engine);
+}
+
+static void un_engine_stats_test(unsigned int seed) {
+    UN_UNUSED(seed);
+    un_engine_t *engine = un_engine_new(1UL);
+    const Ob x = UN_VARS_BEGIN;
+    un_stats_t before, after;
+    un_stats_snapshot_ex(engine, &before);
+    int budget = 10;
+    UN_CHECK_EQ(un_compute_ex(engine, un_parse_string(engine, "S K K x0"),
+                              &budget),
+                x, "u");
+    un_stats_snapshot_ex(engine, &after);
+    if (UN_STATS) {  // S K y z = z is one fused step.
+        UN_CHECK_EQ(after.reductions - before.reductions, 1UL, "lu");
+        UN_CHECK_EQ(after.reductions_by_head.s - before.reductions_by_head.s,
+                    1UL, "lu");
+        UN_CHECK_EQ(after.reductions_by_head.k - before.reductions_by_head.k,
+                    0UL, "lu");
+        UN_CHECK_EQ(after.memo_hits, before.memo_hits, "lu");
+    }
+
+    const Ob kxy = un_parse_string(engine, "K x0 x1");
+    UN_CHECK_EQ(un_simplify_ex(engine, kxy), x, "u");
+    UN_CHECK_EQ(un_simplify_ex(engine, kxy), x, "u");
+    before = after;
+    un_stats_snapshot_ex(engine, &after);
+    if (UN_STATS) {
+        UN_CHECK(after.memo_misses > before.memo_misses, "no memo misses");
+        UN_CHECK(after.memo_hits > before.memo_hits, "no memo hits");
+        uint64_t finds = 0;
+        for (size_t i = 0; i != UN_STATS_PROBE_BUCKETS; ++i) {
+            finds += after.find_probes[i] - before.find_probes[i];
+        }
+        UN_CHECK(finds, "no hash probes");
+    }
+
+    // Grow the memo and free some apps.
+    Ob root = un_parse_string(engine, "S K x0 x1");
+    un_root_ex(engine, &root);
+    for (Ob i = 0; i != 1000U; ++i) {
+        const Ob y = UN_VARS_BEGIN + i % 32U;
+        const Ob z = UN_VARS_BEGIN + i / 32U % 32U;
+        un_simplify_ex(engine, make_app(&engine->structure, kxy,
+                                        make_app(&engine->structure, y, z)));
+    }
+    un_gc_ex(engine, 0);
+    before = after;
+    un_stats_snapshot_ex(engine, &after);
+    if (UN_STATS) UN_CHECK(after.hash_grows > before.hash_grows, "no grows");
+    const Carrier *carrier = &engine->structure.carrier;
+    UN_CHECK(after.carrier_free_list, "no free obs");
+    UN_CHECK_EQ(after.carrier_used + after.carrier_free_list + 1UL,
+                (uint64_t)carrier->free_range, "lu");
+    UN_CHECK_LE(after.memo_count, after.memo_capacity, "lu");
+    UN_CHECK_LE(after.app_count, after.app_capacity, "lu");
+    un_unroot_ex(engine, &root);
+    un_engine_free(engine);
+}
+
+static void un_engine_serialize_test(unsigned int seed) {
+    un_engine_t *engine = un_engine_new(1UL);
+    un_engine_t *twin = un_engine_new(1UL);
+    for (size_t step = 0; step != 20UL; ++step) {
+        Ob ob, twin_ob;
+        random_twin_terms(engine, &ob, twin, &twin_ob,
+                          seed + (unsigned int)step, 2UL * step);
+        size_t size;
+        uint8_t *data = un_serialize_ex(engine, ob, &size);
+        UN_CHECK_EQ(un_deserialize_ex(engine, data, size), ob, "u");
+        UN_CHECK_EQ(un_deserialize_ex(twin, data, size), twin_ob, "u");
+        // Every truncation and corruption is either rejected or valid.
+        for (size_t i = 0; i != size; ++i) {
+            UN_CHECK_EQ(un_deserialize_ex(engine, data, i), 0U, "u");
+            data[i] ^= 0xFFU;
+            un_deserialize_ex(engine, data, size);
+            data[i] ^= 0xFFU;
+        }
+        free(data);
+    }
+
+    // A term with 2^40 leaves serializes to 40 apps.
+    Ob ob = un_parse_string(engine, "x0");
+    Ob twin_ob = un_parse_string(twin, "x0");
+    for (size_t i = 0; i != 40UL; ++i) {
+        ob = make_app(&engine->structure, ob, ob);
+        twin_ob = make_app(&twin->structure, twin_ob, twin_ob);
+    }
+    size_t size;
+    uint8_t *data = un_serialize_ex(engine, ob, &size);
+    UN_CHECK_LE(size, 4UL + 1UL + 1UL + 3UL + 1UL + 40UL * 2UL + 1UL, "zu");
+    UN_CHECK_EQ(un_deserialize_ex(twin, data, size), twin_ob, "u");
+    free(data);
+
+    static const uint8_t invalid[][12] = {
+        {'H', 'S', 'T', 'X', 1, 1, 2, 'x', '0', 0, 1},   // Bad magic.
+        {'H', 'S', 'T', 'R', 2, 1, 2, 'x', '0', 0, 1},   // Bad version.
+        {'H', 'S', 'T', 'R', 1, 1, 2, 'y', '0', 0, 1},   // Bad name.
+        {'H', 'S', 'T', 'R', 1, 1, 2, 'x', '0', 0, 2},   // Bad root.
+        {'H', 'S', 'T', 'R', 1, 1, 2, 'x', '0', 1, 0, 1},  // Bad app.
+    };
+    static const uint8_t valid[] = {'H', 'S', 'T', 'R', 1, 1, 2, 'x', '0', 0,
+                                    1};
+    UN_CHECK_EQ(un_deserialize_ex(engine, valid, sizeof(valid)),
+                UN_VARS_BEGIN, "u");
+    for (size_t i = 0; i != sizeof(invalid) / sizeof(invalid[0]); ++i) {
+        const size_t size = i + 1UL == sizeof(invalid) / sizeof(invalid[0])
+                                ? 12UL
+                                : 11UL;
+        UN_CHECK_EQ(un_deserialize_ex(engine, invalid[i], size), 0U, "u");
+    }
+    un_engine_free(twin);
+    un_engine_free(engine);
+}
+
+#define UN_GC_TEST_ROOTS 20
+
+// Checks that collection preserves rooted terms and memoized results.
+static void un_engine_gc_test(unsigned int seed) {
+    un_engine_t *engine = un_engine_new(1UL);
+    un_engine_t *twin = un_engine_new(1UL);
+    Ob roots[UN_GC_TEST_ROOTS];
+    Ob twin_roots[UN_GC_TEST_ROOTS];
+    for (size_t i = 0; i != UN_GC_TEST_ROOTS; ++i) {
+        random_twin_terms(engine, roots + i, twin, twin_roots + i,
+                          seed + (unsigned int)i, 20UL);
+        roots[i] = un_simplify_ex(engine, roots[i]);
+        twin_roots[i] = un_simplify_ex(twin, twin_roots[i]);
+        un_root_ex(engine, roots + i);
+        // Create garbage.
+        random_linear_term(&engine->structure, 20UL);
+    }
+
+    const Ob free_range = engine->structure.carrier.free_range;
+    UN_CHECK_LT(0UL, un_gc_ex(engine, 0), "zu");
+    UN_CHECK_EQ(engine->structure.carrier.free_range, free_range, "u");
+    if (DEBUG) Structure_validate(&engine->structure);
+    for (size_t i = 0; i != UN_GC_TEST_ROOTS; ++i) {
+        random_linear_term(&engine->structure, 20UL);
+    }
+    UN_CHECK_LT(0UL, un_gc_ex(engine, 1), "zu");
+    UN_CHECK_LT(engine->structure.carrier.free_range, free_range, "u");
+    UN_CHECK_EQ(engine->structure.carrier.free_list, 0U, "u");
+    for (Ob ob = UN_CONSTANTS_END; ob < engine->structure.carrier.free_range;
+         ++ob) {
+        UN_CHECK(Carrier_is_app(&engine->structure.carrier, ob),
+                 "compacted carrier has a hole at %u", ob);
+    }
+    if (DEBUG) Structure_validate(&engine->structure);
+
+    // Check that roots are renumbered and that work continues from them.
+    for (size_t i = 0; i != UN_GC_TEST_ROOTS; ++i) {
+        UN_CHECK(Structure_terms_equal(&engine->structure, roots[i],
+                                       &twin->structure, twin_roots[i]),
+                 "collection changed root %zu", i);
+        const size_t j = (i + 1UL) % UN_GC_TEST_ROOTS;
+        const Ob result = un_simplify_app_ex(engine, roots[i], roots[j]);
+        const Ob twin_result =
+            un_simplify_app_ex(twin, twin_roots[i], twin_roots[j]);
+        UN_CHECK(Structure_terms_equal(&engine->structure, result,
+                                       &twin->structure, twin_result),
+                 "collection changed simplification of root %zu", i);
+    }
+    for (size_t i = 0; i != UN_GC_TEST_ROOTS; ++i) {
+        un_unroot_ex(engine, roots + i);
+    }
+    if (DEBUG) Structure_validate(&engine->structure);
+    un_engine_free(twin);
+    un_engine_free(engine);
+}
+
+// Checks that a term simplifies, or computes if budget >= 0, to another.
+static void un_check_reduces(un_engine_t *engine, const char *text,
+                             int budget, const char *expected) {
+    const Ob ob = un_parse_string(engine, text);
+    UN_CHECK(ob, "failed to parse %s", text);
+    const Ob result = budget < 0 ? un_simplify_ex(engine, ob)
+                                 : un_compute_ex(engine, ob, &budget);
+    char buf[64];
+    un_print_ex(engine, result, buf, sizeof(buf));
+    UN_CHECK_EQ(result, un_parse_string(engine, expected), "u");
+    UN_CHECK(!strcmp(buf, expected), "%s reduced to %s, not %s", text, buf,
+             expected);
+}
+
+static void un_engine_native_test(unsigned int seed) {
+    UN_UNUSED(seed);
+    un_engine_t *engine = un_engine_new(1UL);
+    Structure *structure = &engine->structure;
+
+    // Parse and print.
+    static const char *const texts[] = {
+        "0", "-2147483648", "2147483647", "0x00", "0xff", "ADD 2 -3",
+        "LT 0x07 (MUL x0 10)", "TRUE (EQ FALSE) DIV MOD SUB",
+    };
+    char buf[64];
+    for (size_t i = 0; i != sizeof(texts) / sizeof(texts[0]); ++i) {
+        const Ob ob = un_parse_string(engine, texts[i]);
+        UN_CHECK(ob, "failed to parse %s", texts[i]);
+        un_print_ex(engine, ob, buf, sizeof(buf));
+        UN_CHECK(!strcmp(buf, texts[i]), "printed %s as %s", texts[i], buf);
+    }
+    static const char *const invalid[] = {
+        "-", "-0", "01", "2147483648", "-2147483649", "0x", "0x1", "0xFF",
+        "0x100", "1x", "--1", "+1",
+    };
+    for (size_t i = 0; i != sizeof(invalid) / sizeof(invalid[0]); ++i) {
+        UN_CHECK_EQ(un_parse_string(engine, invalid[i]), 0U, "u");
+    }
+    const Ob seven = un_int_ex(engine, 7);
+    int32_t value = 0;
+    UN_CHECK_EQ(un_parse_string(engine, "7"), seven, "u");
+    UN_CHECK_TRUE(un_int_value_ex(engine, seven, &value));
+    UN_CHECK_EQ(value, 7, "d");
+    UN_CHECK_TRUE(!un_int_value_ex(engine, UN_BYTES_BEGIN + 7U, &value));
+
+    // Operators compute natively, forcing args.
+    un_check_reduces(engine, "ADD 2 3", -1, "5");
+    un_check_reduces(engine, "ADD (MUL 6 7) (SUB 1 2)", -1, "41");
+    un_check_reduces(engine, "DIV -7 2", -1, "-3");
+    un_check_reduces(engine, "MOD -7 2", -1, "-1");
+    un_check_reduces(engine, "ADD 2147483647 1", -1, "-2147483648");
+    un_check_reduces(engine, "DIV -2147483648 -1", -1, "-2147483648");
+    un_check_reduces(engine, "DIV 1 0", -1, "BOT");
+    un_check_reduces(engine, "ADD 0xff 0x02", -1, "0x01");
+    un_check_reduces(engine, "SUB 0x00 0x01", -1, "0xff");
+    un_check_reduces(engine, "LT 0x01 0x02", -1, "TRUE");
+    un_check_reduces(engine, "EQ 3 (ADD 1 2)", -1, "TRUE");
+    un_check_reduces(engine, "EQ TRUE FALSE", -1, "FALSE");
+    un_check_reduces(engine, "LT 2 1 x0 x1", -1, "x1");
+    un_check_reduces(engine, "K (ADD 1 2) x0", -1, "3");
+
+    // Operators are stuck on args that are not native of one kind.
+    un_check_reduces(engine, "ADD 1 0x01", -1, "ADD 1 0x01");
+    un_check_reduces(engine, "ADD x0 (ADD 1 1)", -1, "ADD x0 2");
+    un_check_reduces(engine, "ADD (I x0) 1", -1, "ADD x0 1");
+    un_check_reduces(engine, "LT TRUE FALSE", -1, "LT TRUE FALSE");
+    un_check_reduces(engine, "MUL K", -1, "MUL K");
+
+    // Natives act as Church booleans and numerals.
+    un_check_reduces(engine, "TRUE x0 x1", -1, "x0");
+    un_check_reduces(engine, "FALSE x0 x1", -1, "x1");
+    un_check_reduces(engine, "0 x0 x1", -1, "x1");
+    un_check_reduces(engine, "0x01 x0 x1", -1, "x0 x1");
+    un_check_reduces(engine, "3 x0 x1", -1, "3 x0 x1");
+    un_check_reduces(engine, "3 x0 x1", 10, "x0 (x0 (x0 x1))");
+    un_check_reduces(engine, "0x03 x0 x1", 1, "x0 (0x02 x0 x1)");
+    un_check_reduces(engine, "-1 x0 x1", 10, "-1 x0 x1");
+    un_check_reduces(engine, "MUL 2 (3 (ADD 2) 0)", 10, "12");
+
+    // Church numerals convert as n (ADD 1) 0, where succ = S B.
+    un_check_reduces(engine, "S B (S B (K I)) (ADD 1) 0", 10, "2");
+
+    // Args are forced without recursing.
+    Ob deep = un_int_ex(engine, 0);
+    const Ob add_one = un_parse_string(engine, "ADD 1");
+    for (size_t i = 0; i != 100000UL; ++i) {
+        deep = make_app(structure, add_one, deep);
+    }
+    UN_CHECK_EQ(un_simplify_ex(engine, deep), un_int_ex(engine, 100000),
+                "u");
+
+    // Dead ints are collected, and live ints keep their values.
+    Ob root = un_parse_string(engine, "x0 123456");
+    un_root_ex(engine, &root);
+    for (int compact = 0; compact != 2; ++compact) {
+        for (int32_t i = 0; i != 1000; ++i) un_int_ex(engine, i - 500000);
+        const size_t count = structure->ints.count;
+        UN_CHECK_LE(1000UL, un_gc_ex(engine, compact), "zu");
+        UN_CHECK_LE(structure->ints.count + 1000UL, count, "zu");
+        if (DEBUG) Structure_validate(structure);
+        un_print_ex(engine, root, buf, sizeof(buf));
+        UN_CHECK(!strcmp(buf, "x0 123456"), "printed %s", buf);
+        UN_CHECK_EQ(un_parse_string(engine, "x0 123456"), root, "u");
+    }
+    un_unroot_ex(engine, &root);
+
+    // Ints serialize by value.
+    un_engine_t *twin = un_engine_new(1UL);
+    size_t size;
+    void *data = un_serialize_ex(engine, un_parse_string(engine, "ADD -5 5 "
+                                                         "0x05"),
+                                 &size);
+    const Ob twin_ob = un_deserialize_ex(twin, data, size);
+    UN_CHECK_EQ(twin_ob, un_parse_string(twin, "ADD -5 5 0x05"), "u");
+    free(data);
+    un_engine_free(twin);
+
+    un_engine_free(engine);
+}
+
+static void un_engine_join_test(unsigned int seed) {
+    un_engine_t *engine = un_engine_new(1UL);
+
+    // Simplification applies only the rules of a join semilattice.
+    un_check_reduces(engine, "J x0 x1", -1, "J x0 x1");
+    un_check_reduces(engine, "J TOP x0", -1, "TOP");
+    un_check_reduces(engine, "J x0 TOP x1", -1, "TOP");
+    un_check_reduces(engine, "J BOT x0", -1, "x0");
+    un_check_reduces(engine, "J x0 BOT", -1, "x0");
+    un_check_reduces(engine, "J x0 x0 x1", -1, "x0 x1");
+    un_check_reduces(engine, "J (K x0) (K x0) x1", -1, "x0");
+    un_check_reduces(engine, "J (K x0) (K x1) x2", -1, "J (K x0) (K x1) x2");
+
+    // Distributing over an arg copies it, so spends budget.
+    un_check_reduces(engine, "J (K x0) (K x1) x2", 1, "J x0 x1");
+    un_check_reduces(engine, "J K (K I) x0 x1", 10, "J x0 x1");
+    un_check_reduces(engine, "J K (K I) x0 x1", 1, "J (K x0) I x1");
+
+    // Each path chooses an arg of each J, reproducibly.
+    enum { count = 200 };
+    Ob samples[count];
+    Ob again[count];
+    const Ob x = UN_VARS_BEGIN;
+    const Ob y = UN_VARS_BEGIN + 1U;
+    const Ob term = un_parse_string(engine, "J x0 x1");
+    un_sample_ex(engine, term, count, seed, 0, samples);
+    un_sample_ex(engine, term, count, seed, 0, again);
+    size_t x_count = 0;
+    for (size_t i = 0; i != count; ++i) {
+        UN_CHECK(samples[i] == x || samples[i] == y, "bad sample %u",
+                 samples[i]);
+        UN_CHECK_EQ(samples[i], again[i], "u");
+        x_count += samples[i] == x;
+    }
+    UN_CHECK(50UL < x_count && x_count < 150UL, "biased: %zu", x_count);
+    UN_CHECK_EQ(un_simplify_ex(engine, term), term, "u");  // Not memoized.
+
+    // Samples do not depend on the number of threads.
+    un_engine_t *parallel = un_engine_new_parallel(1UL, 3UL);
+    const char *text = "S I I (J x0 (J x1 TOP))";
+    un_sample_ex(engine, un_parse_string(engine, text), count, seed, 1,
+                 samples);
+    un_sample_ex(parallel, un_parse_string(parallel, text), count, seed, 1,
+                 again);
+    for (size_t i = 0; i != count; ++i) {
+        char buf[64];
+        char parallel_buf[64];
+        un_print_ex(engine, samples[i], buf, sizeof(buf));
+        un_print_ex(parallel, again[i], parallel_buf, sizeof(parallel_buf));
+        UN_CHECK(!strcmp(buf, parallel_buf), "%s != %s", buf, parallel_buf);
+        UN_CHECK(!strchr(buf, 'J'), "unsampled join: %s", buf);
+    }
+    un_engine_free(parallel);
+    un_engine_free(engine);
+}
+
+// Checks that fused rules agree with the steps they fuse.
+static void un_engine_fused_test(unsigned int seed) {
+    UN_UNUSED(seed);
+    un_engine_t *engine = un_engine_new(1UL);
+    un_check_reduces(engine, "K I x0 x1", -1, "x1");
+    un_check_reduces(engine, "K I x0", -1, "I");
+    un_check_reduces(engine, "B I x0 x1", -1, "x0 x1");
+    un_check_reduces(engine, "B I x0", -1, "B I x0");
+    un_check_reduces(engine, "C I x0 x1", -1, "x1 x0");
+    un_check_reduces(engine, "S K x0 x1", -1, "x1");
+    un_check_reduces(engine, "S K x0 x1", 0, "x1");
+    un_check_reduces(engine, "S I x0 x1", -1, "S I x0 x1");
+    un_check_reduces(engine, "S I x0 x1", 1, "x1 (x0 x1)");
+    un_check_reduces(engine, "S B x0 x1", 1, "B x1 (x0 x1)");
+    un_check_reduces(engine, "S B x0 x1 x2", 1, "x1 (x0 x1 x2)");
+    un_check_reduces(engine, "S B (K I) x0 x1", 1, "x0 x1");
+    un_check_reduces(engine, "S (K I) I x0", 1, "x0");
+    un_engine_free(engine);
+}
+
+static void un_check_abstracts(un_engine_t *engine, const char *var,
+                               const char *text, const char *expected) {
+    const Ob ob = un_abstract_ex(engine, un_parse_string(engine, var),
+                                 un_parse_string(engine, text));
+    char buf[64];
+    un_print_ex(engine, ob, buf, sizeof(buf));
+    UN_CHECK(!strcmp(buf, expected), "\\%s.%s abstracted to %s, not %s", var,
+             text, buf, expected);
+}
+
+#define UN_ABSTRACT_TEST_TERMS 32
+
+static void un_engine_abstract_test(unsigned int seed) {
+    un_engine_t *engine = un_engine_new(1UL);
+    Structure *structure = &engine->structure;
+    un_check_abstracts(engine, "x0", "x0", "I");
+    un_check_abstracts(engine, "x0", "x1", "K x1");
+    un_check_abstracts(engine, "x0", "x1 x0", "x1");
+    un_check_abstracts(engine, "x0", "x0 x1", "C I x1");
+    un_check_abstracts(engine, "x0", "x0 x0", "S I I");
+    un_check_abstracts(engine, "x0", "x1 (x2 x0)", "B x1 x2");
+    un_check_abstracts(engine, "x0", "K x0 x1", "C K x1");
+    un_check_abstracts(engine, "x1", "x0 x1 x1", "S x0 I");
+
+    // Abstracting then applying to the variable recovers a normal term.
+    Ob terms[UN_ABSTRACT_TEST_TERMS];
+    Ob vars[UN_ABSTRACT_TEST_TERMS];
+    Ob abstractions[UN_ABSTRACT_TEST_TERMS];
+    srand(seed);
+    for (size_t i = 0; i != UN_ABSTRACT_TEST_TERMS; ++i) {
+        terms[i] = un_simplify_ex(engine, random_linear_term(structure, 20UL));
+        vars[i] = UN_VARS_BEGIN + (Ob)rand() % (UN_VARS_END - UN_VARS_BEGIN);
+        abstractions[i] = un_abstract_ex(engine, vars[i], terms[i]);
+        UN_CHECK(!is_free_in(structure, vars[i], abstractions[i]),
+                 "%u is free", vars[i]);
+        int budget = 1000;
+        const Ob app = make_app(structure, abstractions[i], vars[i]);
+        UN_CHECK_EQ(un_compute_ex(engine, app, &budget), terms[i], "u");
+        un_root_ex(engine, terms + i);
+        un_root_ex(engine, abstractions + i);
+    }
+    Structure_validate(structure);
+
+    // Abstractions are memoized, and survive merges and collection.
+    const size_t count = structure->abs_LRv.count;
+    for (int compact = 0; compact != 2; ++compact) {
+        un_reduce_pending_ex(engine, SIZE_MAX);
+        Structure_validate(structure);
+        un_gc_ex(engine, compact);
+        Structure_validate(structure);
+        for (size_t i = 0; i != UN_ABSTRACT_TEST_TERMS; ++i) {
+            UN_CHECK_EQ(un_abstract_ex(engine, vars[i], terms[i]),
+                        abstractions[i], "u");
+        }
+    }
+    UN_CHECK_LE(structure->abs_LRv.count, count, "zu");
+    un_engine_free(engine);
+}
+
+// Checks that a bounded memo evicts rather than grows, and that evictions
+// change no results.
+static void un_engine_memo_limit_test(unsigned int seed) {
+    un_engine_t *bounded = un_engine_new(1UL);
+    un_engine_t *unbounded = un_engine_new(1UL);
+    un_stats_t before, after;
+    un_stats_snapshot_ex(bounded, &before);
+    for (size_t step = 0; step != 200UL; ++step) {
+        // Shrink once the memo has grown past the limit.
+        if (step == 100UL) un_set_memo_limit_ex(bounded, 1024UL);
+        Ob bounded_term, unbounded_term;
+        random_twin_terms(bounded, &bounded_term, unbounded, &unbounded_term,
+                          seed + (unsigned int)step, 30UL);
+        UN_CHECK(Structure_terms_equal(
+                     &bounded->structure, un_simplify_ex(bounded, bounded_term),
+                     &unbounded->structure,
+                     un_simplify_ex(unbounded, unbounded_term)),
+                 "bounded simplification disagrees at step %zu", step);
+        if (step >= 100UL) {
+            UN_CHECK_LE(bounded->structure.hash.size * sizeof(Hash_Node),
+                        1024UL, "zu");
+        }
+    }
+    un_stats_snapshot_ex(bounded, &after);
+    if (UN_STATS) {
+        UN_CHECK(after.memo_evictions > before.memo_evictions, "no evictions");
+    }
+    UN_CHECK_LE(after.memo_count, 32UL, "lu");
+
+    // Check that hits on an unbounded memo write nothing to it.
+    const Hash *memo = &unbounded->structure.hash;
+    for (size_t i = 0; i != memo->size; ++i) {
+        UN_CHECK(!memo->nodes[i].slot.spare[UN_HASH_REFERENCED],
+                 "unbounded memo entry %zu was touched", i);
+    }
+    un_gc_ex(bounded, 1);
+    Structure_validate(&bounded->structure);
+    un_engine_free(unbounded);
+    un_engine_free(bounded);
+}
+
+void un_test(unsigned int seed) {
+    AbsList_test(seed);
+    Epoch_test(seed);
+    Hash_test(seed);
+    InverseHash_test(seed);
+    ObQueue_test(seed);
+    UnionFind_test(seed);
+    Carrier_test(seed);
+    Structure_test(seed);
+    Structure_merge_test(seed);
+    simplify_deep_test(seed);
+    abstract_deep_test(seed);
+    un_engine_shared_test(seed);
+    un_engine_parallel_test(seed);
+    un_engine_no_slot_test(seed);
+    un_engine_snapshot_test(seed);
+    un_engine_gc_test(seed);
+    un_engine_compute_test(seed);
+    un_engine_batch_test(seed);
+    un_engine_parse_test(seed);
+    un_engine_stats_test(seed);
+    un_engine_serialize_test(seed);
+    un_engine_native_test(seed);
+    un_engine_join_test(seed);
+    un_engine_fused_test(seed);
+    un_engine_abstract_test(seed);
+    un_engine_memo_limit_test(seed);
+}
@@ -2,18 +2,210 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/types.h>
 
 /* Ob is a 1-based pointer type; 0 denotes null. */
 typedef uint32_t Ob;
 
+// An engine owns all state needed for reduction. Engines share nothing, so
+// each may be driven by its own thread. A single engine is safe to use from
+// multiple threads at once only if it was created by un_engine_new_shared.
+typedef struct un_engine un_engine_t;
+
+// Creates an engine with initial space for roughly capacity obs,
+// or a default capacity if 0. Its tables hold that many apps and memo
+// entries without growing, so a good hint avoids growth altogether. Beyond
+// it, tables grow incrementally rather than pausing to rehash.
+un_engine_t *un_engine_new(size_t capacity);
+
+// Creates an engine that may be used from many threads. Memoized
+// un_simplify_app_ex lookups are lock-free; all other work is serialized.
+un_engine_t *un_engine_new_shared(size_t capacity);
+
+// Creates a shared engine that simplifies large independent args in
+// parallel, using num_threads threads including the caller's.
+un_engine_t *un_engine_new_parallel(size_t capacity, size_t num_threads);
+
+// Opens an engine from a snapshot, mapping it copy-on-write so that it
+// serves lookups without a parse step. Returns NULL and sets errno on error.
+un_engine_t *un_engine_open_snapshot(const char *path);
+
+// Writes a snapshot of an engine. Returns 0 on success, else an errno value.
+int un_engine_save_snapshot(un_engine_t *engine, const char *path);
+
+// Like un_engine_save_snapshot, but writes from a forked child, so that the
+// engine is blocked only while forking. Returns the child's pid, which exits
+// with status 0 on success, or -1 and sets errno if fork fails.
+pid_t un_engine_checkpoint(un_engine_t *engine, const char *path);
+void un_engine_free(un_engine_t *engine);
+
+// Builds the app lhs rhs without reducing it. Apps are hash-consed, so
+// building an equal pair again returns the same ob.
+Ob un_app_ex(un_engine_t *engine, Ob lhs, Ob rhs);
+
+// Sets out[i] to the app lhs[i] rhs[i], for i < count. This is faster than
+// building apps one at a time, since lookups overlap.
+void un_app_many_ex(un_engine_t *engine, const Ob *lhs, const Ob *rhs,
+                    Ob *out, size_t count);
+
+// Returns the ob of a native int, hash-consed like apps. Native ints act as
+// Church numerals, as do the bytes 0x00, ..., 0xff, and TRUE and FALSE act
+// as Church booleans. The operators ADD, SUB, MUL, DIV, MOD, EQ and LT
+// compute on natives as the CPU does. A Church numeral n converts to a
+// native int as n (ADD 1) 0, and a Church boolean b as b TRUE FALSE.
+Ob un_int_ex(un_engine_t *engine, int32_t value);
+
+// Sets *value and returns 1 if ob is a native int, or else returns 0.
+int un_int_value_ex(un_engine_t *engine, Ob ob, int32_t *value);
+
+Ob un_simplify_ex(un_engine_t *engine, Ob ob);
+Ob un_simplify_app_ex(un_engine_t *engine, Ob lhs, Ob rhs);
+
+// Sets out[i] to the simplification of lhs[i] rhs[i], for i < count. This
+// is faster than simplifying apps one at a time, since memo lookups overlap.
+void un_simplify_app_batch_ex(un_engine_t *engine, const Ob *lhs,
+                              const Ob *rhs, Ob *out, size_t count);
+size_t un_reduce_pending_ex(un_engine_t *engine, size_t max_count);
+
+// Computes an ob, spending one unit of budget per non-linear step. Once the
+// budget is spent, the result is finished by linear reduction only.
+Ob un_compute_ex(un_engine_t *engine, Ob ob, int *budget);
+Ob un_compute_app_ex(un_engine_t *engine, Ob lhs, Ob rhs, int *budget);
+
+// Draws n_samples reduction paths of a term, in which each J x y reduces
+// to x or to y at random, and sets out[i] to the result of path i. Each
+// path spends its own budget as in un_compute_ex. Path i depends only on
+// the term, seed and i, so samples are reproducible whatever the number of
+// threads. Parallel engines spread paths over their threads, which share
+// the term's simplification but do not memoize their choices.
+void un_sample_ex(un_engine_t *engine, Ob ob, size_t n_samples, uint64_t seed,
+                  int budget, Ob *out);
+
+// Returns \var.ob, a term f without var such that f var = ob, where var is
+// a variable such as x0 from un_parse_ex. Abstractions are memoized, and
+// reuse subterms not mentioning var, so repeating one is O(1).
+Ob un_abstract_ex(un_engine_t *engine, Ob var, Ob ob);
+
+// A computation suspended when its budget ran out.
+typedef struct un_suspension un_suspension_t;
+
+// Like un_compute_ex, but if the budget runs out, returns 0 and sets
+// *suspension to a token that continues the computation. Tokens keep their
+// obs alive across un_gc_ex, and must be freed before their engine.
+Ob un_compute_resumable_ex(un_engine_t *engine, Ob ob, int *budget,
+                           un_suspension_t **suspension);
+
+// Continues a suspended computation with a new budget. Returns its result
+// and frees the token, or returns 0 if the budget runs out again.
+Ob un_compute_resume(un_suspension_t *suspension, int *budget);
+
+// Abandons a suspended computation.
+void un_suspension_free(un_suspension_t *suspension);
+
+// Registers a caller's handle as a root for garbage collection. Collection
+// keeps rooted obs alive, and updates each root when it renumbers obs.
+void un_root_ex(un_engine_t *engine, Ob *root);
+void un_unroot_ex(un_engine_t *engine, Ob *root);
+
+// Frees obs unreachable from roots, returning the number freed. If compact
+// is nonzero, also renumbers live obs densely, which invalidates every
+// handle that is not a root.
+size_t un_gc_ex(un_engine_t *engine, int compact);
+
+// Bounds the memory of the memo of simplifications to max_bytes, rounded
+// down to a power of 2 of at least 64 bytes, or lifts the bound if 0. A
+// bounded memo evicts rarely hit entries instead of growing, shrinking at
+// once if already larger. Evicted simplifications are recomputed if needed
+// again, so eviction changes only performance.
+void un_set_memo_limit_ex(un_engine_t *engine, size_t max_bytes);
+
+// Parses a term such as "S K (K x0) x1", where application associates to
+// the left, x0, ..., x31 are variables and J x y is the join of x and y.
+// Returns 0 on a syntax error.
+Ob un_parse_ex(un_engine_t *engine, const char *text, size_t size);
+
+// Prints a term in the syntax of un_parse_ex. Like snprintf, this writes at
+// most size bytes including a terminating nul, and returns the length of
+// the whole text. Shared engines print without blocking other threads.
+size_t un_print_ex(un_engine_t *engine, Ob ob, char *buf, size_t size);
+
+// Serializes a term to a compact binary DAG, in which each distinct
+// subterm appears once. Returns a buffer that the caller must free(), and
+// sets *size to its length.
+void *un_serialize_ex(un_engine_t *engine, Ob ob, size_t *size);
+
+// Builds a term from the output of un_serialize_ex, possibly from another
+// engine. Returns 0 if the data is invalid.
+Ob un_deserialize_ex(un_engine_t *engine, const void *data, size_t size);
+
+#define UN_STATS_PROBE_BUCKETS 16
+
+// Runtime statistics. Counters are kept per thread and summed over every
+// thread of the process, so they include the work of all engines. They are
+// zero if the library was built with -DHSTAR_NO_STATS. Gauges describe one
+// engine.
+typedef struct {
+    // Counters.
+    uint64_t reductions;  // Steps that fired a reduction rule.
+    struct {
+        uint64_t top, bot, i, k, b, c, s, j;
+        uint64_t native;  // Booleans, operators and numerals.
+    } reductions_by_head;
+    uint64_t memo_hits;    // Apps found already simplified.
+    uint64_t memo_misses;  // Apps simplified afresh.
+    // Hash lookups and inserts that visited [2^i, 2^(i+1)) cache lines,
+    // with the last bucket counting all longer probes.
+    uint64_t find_probes[UN_STATS_PROBE_BUCKETS];
+    uint64_t insert_probes[UN_STATS_PROBE_BUCKETS];
+    uint64_t hash_grows;
+    uint64_t hash_grow_ns;    // Total time spent growing, as sampled.
+    uint64_t memo_evictions;  // Entries dropped by a memo limit.
+
+    // Gauges.
+    uint64_t carrier_used;  // Obs allocated, including atoms.
+    uint64_t carrier_free_list;
+    uint64_t carrier_capacity;
+    uint64_t memo_count;  // Memoized simplifications.
+    uint64_t memo_capacity;
+    uint64_t app_count;  // Hash-consed apps.
+    uint64_t app_capacity;
+} un_stats_t;
+
+void un_stats_snapshot_ex(un_engine_t *engine, un_stats_t *stats);
+
+// The following functions operate on a default engine.
+
 // Must be called before other un_* methods.
-// This is safe to call repeatedly.
-void un_init();
+// This is safe to call repeatedly, from any thread.
+void un_init(void);
 
+Ob un_app(Ob lhs, Ob rhs);
+void un_app_many(const Ob *lhs, const Ob *rhs, Ob *out, size_t count);
+Ob un_int(int32_t value);
+int un_int_value(Ob ob, int32_t *value);
 Ob un_simplify(Ob ob);
 Ob un_simplify_app(Ob lhs, Ob rhs);
+void un_simplify_app_batch(const Ob *lhs, const Ob *rhs, Ob *out,
+                           size_t count);
+
+// Simplifies up to max_count pending apps, most referenced first.
+// Returns the number simplified.
+size_t un_reduce_pending(size_t max_count);
 
 Ob un_compute(Ob ob, int *budget);
 Ob un_compute_app(Ob lhs, Ob rhs, int *budget);
+Ob un_compute_resumable(Ob ob, int *budget, un_suspension_t **suspension);
+void un_sample(Ob ob, size_t n_samples, uint64_t seed, int budget, Ob *out);
+Ob un_abstract(Ob var, Ob ob);
+
+void un_root(Ob *root);
+void un_unroot(Ob *root);
+size_t un_gc(int compact);
+void un_set_memo_limit(size_t max_bytes);
+Ob un_parse(const char *text, size_t size);
+size_t un_print(Ob ob, char *buf, size_t size);
+void *un_serialize(Ob ob, size_t *size);
+Ob un_deserialize(const void *data, size_t size);
+void un_stats_snapshot(un_stats_t *stats);
 
 void un_test(unsigned int seed);